@@ -0,0 +1,415 @@
+/*
+ * charset.c: UTF-8 validation and table driven conversion from
+ *            UTF-8 to single byte charsets
+ *
+ * Copyright (c) 2006-2009 Dennis Stosberg <dennis@stosberg.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2 as published by the Free Software Foundation
+ */
+
+#include <ctype.h>
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+#include "charset.h"
+#include "mem.h"
+#include "regex.h"
+
+/* eight consecutive characters */
+#define ROW(c) (c), (c) + 1, (c) + 2, (c) + 3, (c) + 4, (c) + 5, (c) + 6, (c) + 7
+
+/*
+ * The characters of the bytes 0x80-0xff, 0 where a byte is unused.
+ */
+static const unsigned short latin1_high[128] = {
+	ROW(0x0080), ROW(0x0088), ROW(0x0090), ROW(0x0098),
+	ROW(0x00a0), ROW(0x00a8), ROW(0x00b0), ROW(0x00b8),
+	ROW(0x00c0), ROW(0x00c8), ROW(0x00d0), ROW(0x00d8),
+	ROW(0x00e0), ROW(0x00e8), ROW(0x00f0), ROW(0x00f8)
+};
+
+static const unsigned short latin9_high[128] = {
+	ROW(0x0080), ROW(0x0088), ROW(0x0090), ROW(0x0098),
+	0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x20ac, 0x00a5, 0x0160, 0x00a7,
+	0x0161, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+	0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x017d, 0x00b5, 0x00b6, 0x00b7,
+	0x017e, 0x00b9, 0x00ba, 0x00bb, 0x0152, 0x0153, 0x0178, 0x00bf,
+	ROW(0x00c0), ROW(0x00c8), ROW(0x00d0), ROW(0x00d8),
+	ROW(0x00e0), ROW(0x00e8), ROW(0x00f0), ROW(0x00f8)
+};
+
+static const unsigned short cp1252_high[128] = {
+	0x20ac, 0x0000, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,
+	0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0x0000, 0x017d, 0x0000,
+	0x0000, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+	0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0x0000, 0x017e, 0x0178,
+	ROW(0x00a0), ROW(0x00a8), ROW(0x00b0), ROW(0x00b8),
+	ROW(0x00c0), ROW(0x00c8), ROW(0x00d0), ROW(0x00d8),
+	ROW(0x00e0), ROW(0x00e8), ROW(0x00f0), ROW(0x00f8)
+};
+
+struct charset_pair {
+	unsigned short ucs;
+	unsigned char byte;
+};
+
+/*
+ * The reverse of a table of high characters, built by charset_find.
+ */
+struct charset_rev {
+	int built;
+	unsigned char page0[128];       /* U+0080-U+00FF, 0 if missing */
+	struct charset_pair other[128]; /* sorted by ucs */
+	int num_other;
+};
+
+/* one for each of charsets */
+static struct charset_rev reverse[4];
+
+struct charset {
+	const char *names[8];           /* normalized, see normalize() */
+	const unsigned short *high;     /* NULL for US-ASCII */
+	struct charset_rev *rev;
+};
+
+static struct charset charsets[] = {
+	{ { "iso88591", "iso885911987", "latin1", "l1", "cp819", "ibm819",
+	    NULL }, latin1_high, &reverse[0] },
+	{ { "iso885915", "latin9", "latin0", "l9", NULL }, latin9_high,
+	  &reverse[1] },
+	{ { "cp1252", "windows1252", "ms1252", NULL }, cp1252_high,
+	  &reverse[2] },
+	{ { "usascii", "ascii", "ansix3.41968", "iso646us", "us", NULL },
+	  NULL, &reverse[3] },
+};
+
+#define NUM_CHARSETS (sizeof(charsets) / sizeof(charsets[0]))
+
+static void normalize(char *dst, size_t size, const char *name)
+{
+	size_t n = 0;
+
+	for (; *name && n + 1 < size; name++) {
+		if (*name == '-' || *name == '_')
+			continue;
+		dst[n++] = (char)tolower((unsigned char)*name);
+	}
+	dst[n] = '\0';
+}
+
+static void build(struct charset *cs)
+{
+	struct charset_rev *rev = cs->rev;
+	struct charset_pair tmp;
+	int i, j;
+
+	if (rev->built || !cs->high) {
+		rev->built = 1;
+		return;
+	}
+
+	for (i = 0; i < 128; i++) {
+		unsigned short ucs = cs->high[i];
+
+		if (!ucs)
+			continue;
+		if (ucs < 0x100) {
+			rev->page0[ucs - 0x80] = (unsigned char)(0x80 + i);
+			continue;
+		}
+		rev->other[rev->num_other].ucs = ucs;
+		rev->other[rev->num_other].byte = (unsigned char)(0x80 + i);
+		rev->num_other++;
+	}
+
+	/* insertion sort, there are only a few of them */
+	for (i = 1; i < rev->num_other; i++) {
+		tmp = rev->other[i];
+		for (j = i; j > 0 && rev->other[j - 1].ucs > tmp.ucs; j--)
+			rev->other[j] = rev->other[j - 1];
+		rev->other[j] = tmp;
+	}
+	rev->built = 1;
+}
+
+const struct charset *charset_find(const char *name)
+{
+	char norm[32];
+	size_t i;
+	int j;
+
+	if (strlen(name) >= sizeof(norm))
+		return NULL;
+	normalize(norm, sizeof(norm), name);
+
+	for (i = 0; i < NUM_CHARSETS; i++) {
+		for (j = 0; charsets[i].names[j]; j++) {
+			if (!strcmp(norm, charsets[i].names[j])) {
+				build(&charsets[i]);
+				return &charsets[i];
+			}
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Returns the byte for the character ucs, or -1 if cs does not
+ * contain it.
+ */
+static int lookup(const struct charset *cs, unsigned long ucs)
+{
+	const struct charset_rev *rev = cs->rev;
+	int lo, hi, mid;
+
+	if (ucs < 0x80)
+		return (int)ucs;
+	if (!cs->high)
+		return -1;
+	if (ucs < 0x100)
+		return rev->page0[ucs - 0x80] ? rev->page0[ucs - 0x80] : -1;
+
+	lo = 0;
+	hi = rev->num_other;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (rev->other[mid].ucs == ucs)
+			return rev->other[mid].byte;
+		if (rev->other[mid].ucs < ucs)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return -1;
+}
+
+/*
+ * Decodes the sequence at p.  Returns its length, or 0 if it is
+ * not valid UTF-8.  Overlong forms, surrogates and characters above
+ * U+10FFFF are rejected, as iconv does.
+ */
+static size_t decode(const unsigned char *p, const unsigned char *end,
+		     unsigned long *ucs)
+{
+	size_t len, i;
+	unsigned char lo = 0x80, hi = 0xbf;
+
+	if (*p < 0x80) {
+		*ucs = *p;
+		return 1;
+	} else if (*p < 0xc2) {
+		return 0;
+	} else if (*p < 0xe0) {
+		len = 2;
+		*ucs = *p & 0x1f;
+	} else if (*p < 0xf0) {
+		len = 3;
+		*ucs = *p & 0x0f;
+		if (*p == 0xe0)
+			lo = 0xa0;
+		else if (*p == 0xed)
+			hi = 0x9f;
+	} else if (*p < 0xf5) {
+		len = 4;
+		*ucs = *p & 0x07;
+		if (*p == 0xf0)
+			lo = 0x90;
+		else if (*p == 0xf4)
+			hi = 0x8f;
+	} else {
+		return 0;
+	}
+
+	if ((size_t)(end - p) < len)
+		return 0;
+	if (p[1] < lo || p[1] > hi)
+		return 0;
+	for (i = 1; i < len; i++) {
+		if ((p[i] & 0xc0) != 0x80)
+			return 0;
+		*ucs = (*ucs << 6) | (p[i] & 0x3f);
+	}
+	return len;
+}
+
+int charset_has(const struct charset *cs, const char *utf8)
+{
+	const unsigned char *p = (const unsigned char *)utf8;
+	unsigned long ucs;
+
+	if (!decode(p, p + strlen(utf8), &ucs))
+		return 0;
+	return lookup(cs, ucs) != -1;
+}
+
+/*
+ * Returns the number of ASCII bytes at the start of p.
+ */
+static size_t ascii_span(const unsigned char *p, const unsigned char *end)
+{
+	const unsigned char *start = p;
+
+#ifdef __SSE2__
+	while (end - p >= 16) {
+		int mask = _mm_movemask_epi8(
+			_mm_loadu_si128((const __m128i *)p));
+		if (mask)
+			break;
+		p += 16;
+	}
+#else
+	unsigned long word;
+
+	while ((size_t)(end - p) >= sizeof(word)) {
+		memcpy(&word, p, sizeof(word));
+		if (word & ((unsigned long)-1 / 0xff * 0x80))
+			break;
+		p += sizeof(word);
+	}
+#endif
+	while (p < end && *p < 0x80)
+		p++;
+	return (size_t)(p - start);
+}
+
+size_t utf8_valid_len(const char *in, size_t len)
+{
+	const unsigned char *p = (const unsigned char *)in;
+	const unsigned char *end = p + len;
+	unsigned long ucs;
+	size_t n;
+
+	while (p < end) {
+		p += ascii_span(p, end);
+		if (p == end)
+			break;
+		n = decode(p, end, &ucs);
+		if (!n)
+			break;
+		p += n;
+	}
+	return (size_t)(p - (const unsigned char *)in);
+}
+
+/*
+ * Returns the length of the invalid sequence at p: the lead byte and
+ * the continuation bytes which could still have completed it.
+ */
+static size_t invalid_len(const unsigned char *p, const unsigned char *end)
+{
+	unsigned char lo = 0x80, hi = 0xbf;
+	size_t len, i;
+
+	if (*p < 0xc2 || *p > 0xf4)
+		return 1;
+	len = *p < 0xe0 ? 2 : *p < 0xf0 ? 3 : 4;
+	if (*p == 0xe0)
+		lo = 0xa0;
+	else if (*p == 0xed)
+		hi = 0x9f;
+	else if (*p == 0xf0)
+		lo = 0x90;
+	else if (*p == 0xf4)
+		hi = 0x8f;
+
+	for (i = 1; i < len && p + i < end; i++) {
+		if (p[i] < lo || p[i] > hi)
+			break;
+		lo = 0x80;
+		hi = 0xbf;
+	}
+	return i;
+}
+
+size_t utf8_repair(STRBUF *buf)
+{
+	const char *start = strbuf_get(buf);
+	const char *end = start + strbuf_len(buf);
+	const char *p = start;
+	const char *bad;
+	size_t count = 0;
+	struct strbuf_rewrite rw;
+
+	bad = p + utf8_valid_len(p, (size_t)(end - p));
+	if (bad == end)
+		return 0;
+
+	/* a sequence is replaced by a single byte, in place */
+	strbuf_rewrite_init(&rw, buf);
+	while (bad < end) {
+		p = bad + invalid_len((const unsigned char *)bad,
+				      (const unsigned char *)end);
+		strbuf_rewrite_keep(&rw, (size_t)(bad - start));
+		strbuf_rewrite_skip(&rw, (size_t)(p - start));
+		strbuf_rewrite_put(&rw, "?", 1);
+		count++;
+		bad = p + utf8_valid_len(p, (size_t)(end - p));
+	}
+	strbuf_rewrite_finish(&rw);
+
+	return count;
+}
+
+/*
+ * Converts len bytes of UTF-8 at in to cs and writes them to out,
+ * which may be in itself.  Returns the number of bytes written.
+ */
+static size_t conv_bytes(const struct charset *cs, const char *in,
+			 size_t len, char *out)
+{
+	const unsigned char *p = (const unsigned char *)in;
+	const unsigned char *end = p + len;
+	char *start = out;
+	unsigned long ucs;
+	size_t n, skip;
+	int byte;
+
+	/* every character and every error gives at most one byte */
+	while (p < end) {
+		n = ascii_span(p, end);
+		if (out != (const char *)p)
+			memmove(out, p, n);
+		out += n;
+		p += n;
+		if (p == end)
+			break;
+
+		n = decode(p, end, &ucs);
+		byte = n ? lookup(cs, ucs) : -1;
+		if (byte != -1) {
+			*out++ = (char)byte;
+			p += n;
+			continue;
+		}
+
+		/* skip like conv does after an iconv error */
+		skip = 1;
+		if (*p > 0x80)
+			skip += utf8_length[*p - 0x80];
+		if (skip > (size_t)(end - p))
+			skip = (size_t)(end - p);
+		*out++ = '?';
+		p += skip;
+	}
+
+	return (size_t)(out - start);
+}
+
+STRBUF *charset_conv(const struct charset *cs, const char *in, size_t len)
+{
+	STRBUF *output = strbuf_new();
+
+	strbuf_setopt(output, STRBUF_NULLOK);
+	strbuf_commit(output, conv_bytes(cs, in, len,
+					 strbuf_reserve(output, len)));
+	return output;
+}
+
+void charset_conv_buf(const struct charset *cs, STRBUF *buf)
+{
+	strbuf_setopt(buf, STRBUF_NULLOK);
+	strbuf_truncate(buf, conv_bytes(cs, buf->data, buf->len, buf->data));
+}
@@ -0,0 +1,59 @@
+/*
+ * charset.c: UTF-8 validation and table driven conversion from
+ *            UTF-8 to single byte charsets
+ *
+ * Copyright (c) 2006-2009 Dennis Stosberg <dennis@stosberg.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2 as published by the Free Software Foundation
+ */
+
+#ifndef CHARSET_H
+#define CHARSET_H
+
+#include <stddef.h>
+
+#include "strbuf.h"
+
+struct charset;
+
+/*
+ * Returns the table for the charset called name, or NULL if there
+ * is none and the conversion has to be done by iconv.  Names are
+ * compared without regard to case, '-' and '_'.
+ */
+const struct charset *charset_find(const char *name);
+
+/*
+ * Returns 1 if the UTF-8 sequence at utf8 is a character contained
+ * in cs, 0 otherwise.
+ */
+int charset_has(const struct charset *cs, const char *utf8);
+
+/*
+ * Converts len bytes of UTF-8 at in to cs.  Characters which cs does
+ * not contain and invalid sequences are replaced by '?', skipping as
+ * many bytes as conv does after an iconv error.
+ */
+STRBUF *charset_conv(const struct charset *cs, const char *in, size_t len);
+
+/*
+ * Like charset_conv, but converts buf in place.
+ */
+void charset_conv_buf(const struct charset *cs, STRBUF *buf);
+
+/*
+ * Returns the length of the longest prefix of in which is valid
+ * UTF-8.
+ */
+size_t utf8_valid_len(const char *in, size_t len);
+
+/*
+ * Replaces every invalid sequence in buf by '?'.  An invalid sequence
+ * is a stray byte or the start of a character which is cut short;
+ * the following bytes are kept.  Returns the number of replacements.
+ */
+size_t utf8_repair(STRBUF *buf);
+
+#endif /* CHARSET_H */
@@ -0,0 +1,189 @@
+/* Generated by tools/genelem.  Do not edit. */
+
+#include <string.h>
+
+#include "odf.h"
+
+static const char *const names[] = {
+	"",
+	"office:body",
+	"office:text",
+	"office:presentation",
+	"text:p",
+	"text:h",
+	"text:span",
+	"text:a",
+	"text:tab",
+	"text:s",
+	"text:line-break",
+	"text:soft-page-break",
+	"text:list",
+	"text:list-item",
+	"text:note",
+	"text:note-body",
+	"text:bookmark",
+	"text:sequence-decls",
+	"text:section",
+	"table:table",
+	"table:table-column",
+	"table:table-row",
+	"table:table-cell",
+	"draw:page",
+	"draw:frame",
+	"draw:image",
+	"draw:text-box",
+	"draw:object",
+	"presentation:notes",
+};
+
+static const unsigned char lengths[] = {
+	0, 11, 11, 19, 6, 6, 9, 6, 8, 6, 15, 20, 9, 14, 9, 14,
+	13, 19, 12, 11, 18, 15, 16, 9, 10, 10, 13, 11, 18
+};
+
+static const enum odf_element slots[128] = {
+	ODF_UNKNOWN,
+	ODF_TABLE_TABLE_COLUMN,
+	ODF_UNKNOWN,
+	ODF_DRAW_IMAGE,
+	ODF_TEXT_TAB,
+	ODF_TEXT_NOTE,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_TEXT_SEQUENCE_DECLS,
+	ODF_TEXT_LIST,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_OFFICE_PRESENTATION,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_TEXT_BOOKMARK,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_TABLE_TABLE,
+	ODF_DRAW_PAGE,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_TEXT_H,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_TEXT_A,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_TEXT_LINE_BREAK,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_TABLE_TABLE_CELL,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_DRAW_FRAME,
+	ODF_OFFICE_BODY,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_TEXT_LIST_ITEM,
+	ODF_TEXT_NOTE_BODY,
+	ODF_PRESENTATION_NOTES,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_DRAW_TEXT_BOX,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_TEXT_SECTION,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_TEXT_SPAN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_TABLE_TABLE_ROW,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_TEXT_P,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_DRAW_OBJECT,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_OFFICE_TEXT,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_TEXT_SOFT_PAGE_BREAK,
+	ODF_TEXT_S,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+	ODF_UNKNOWN,
+};
+
+enum odf_element odf_element(const char *name, size_t len)
+{
+	unsigned int h = 2166136278u;
+	enum odf_element e;
+	size_t i;
+
+	if (len > 20)
+		return ODF_UNKNOWN;
+	for (i = 0; i < len; i++)
+		h = (h ^ (unsigned char)name[i]) * 16777619u;
+	e = slots[h & 127];
+	if (lengths[e] != len || memcmp(names[e], name, len))
+		return ODF_UNKNOWN;
+	return e;
+}
@@ -0,0 +1,243 @@
+/*
+ * ir.c: A compact intermediate representation of formatted documents
+ *
+ * Copyright (c) 2006-2009 Dennis Stosberg <dennis@stosberg.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2 as published by the Free Software Foundation
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mem.h"
+#include "ir.h"
+
+static const char ir_magic[] = "odt2txt-ir";
+static const unsigned char ir_version = 3;
+
+void ir_put_varint(STRBUF *buf, unsigned long long v)
+{
+	char c;
+
+	while (v >= 0x80) {
+		c = (char)(0x80 | (v & 0x7f));
+		strbuf_append_n(buf, &c, 1);
+		v >>= 7;
+	}
+	c = (char)v;
+	strbuf_append_n(buf, &c, 1);
+}
+
+int ir_get_varint(const char **p, const char *end, unsigned long long *v)
+{
+	int shift = 0;
+
+	*v = 0;
+	while (*p < end && shift < 64) {
+		unsigned char c = (unsigned char)*(*p)++;
+		*v |= (unsigned long long)(c & 0x7f) << shift;
+		if (!(c & 0x80))
+			return 0;
+		shift += 7;
+	}
+	return -1;
+}
+
+static void put_record(STRBUF *ir, enum ir_record type,
+		       const char *text, size_t len)
+{
+	char c = (char)type;
+
+	strbuf_append_n(ir, &c, 1);
+	ir_put_varint(ir, len);
+	if (type != IR_BREAK)
+		strbuf_append_n(ir, text, len);
+}
+
+STRBUF *ir_encode(STRBUF *doc)
+{
+	const char *p = strbuf_get(doc);
+	const char *end = p + strbuf_len(doc);
+	const char *q;
+	STRBUF *ir = strbuf_new();
+
+	strbuf_setopt(ir, STRBUF_NULLOK);
+
+	while (p < end) {
+		if (*p == '\n') {
+			for (q = p; q < end && *q == '\n'; q++)
+				;
+			put_record(ir, IR_BREAK, NULL, (size_t)(q - p));
+		} else if (*p == IR_MARK && p + 1 < end &&
+			   (p[1] == '=' || p[1] == '-')) {
+			enum ir_record type = p[1] == '=' ? IR_H1 : IR_H2;
+
+			p += 2;
+			q = memchr(p, IR_MARK_END, (size_t)(end - p));
+			if (!q)
+				q = end;
+			put_record(ir, type, p, (size_t)(q - p));
+			if (q < end)
+				q++;
+		} else {
+			/* a mark without a type is text */
+			for (q = p + 1; q < end && *q != '\n' && *q != IR_MARK;
+			     q++)
+				;
+			put_record(ir, IR_TEXT, p, (size_t)(q - p));
+		}
+		p = q;
+	}
+	put_record(ir, IR_END, NULL, 0);
+
+	return ir;
+}
+
+STRBUF *ir_decode(STRBUF *ir)
+{
+	const char *p = strbuf_get(ir);
+	const char *end = p + strbuf_len(ir);
+	STRBUF *doc = strbuf_new();
+	unsigned long long len;
+	enum ir_record type;
+
+	while (p < end) {
+		type = (enum ir_record)*p++;
+		if (ir_get_varint(&p, end, &len) == -1)
+			break;
+
+		switch (type) {
+		case IR_END:
+			return doc;
+		case IR_BREAK:
+			while (len--)
+				strbuf_append_n(doc, "\n", 1);
+			continue;
+		case IR_H1:
+		case IR_H2:
+			strbuf_append_n(doc, type == IR_H1 ? "\001=" : "\001-", 2);
+			break;
+		case IR_TEXT:
+			break;
+		default:
+			strbuf_free(doc);
+			return NULL;
+		}
+
+		if (len > (unsigned long long)(end - p))
+			break;
+		strbuf_append_n(doc, p, (size_t)len);
+		p += len;
+		if (type != IR_TEXT)
+			strbuf_append_n(doc, "\002", 1);
+	}
+
+	/* truncated */
+	strbuf_free(doc);
+	return NULL;
+}
+
+/*
+ * The cache key is the file name together with the size and
+ * modification time of the file.
+ */
+static void cache_key(STRBUF *key, const char *filename,
+		      const struct stat *st)
+{
+	strbuf_append_n(key, ir_magic, sizeof(ir_magic));
+	strbuf_append_n(key, (const char *)&ir_version, 1);
+	ir_put_varint(key, (unsigned long long)st->st_size);
+	ir_put_varint(key, (unsigned long long)st->st_mtime);
+	ir_put_varint(key, (unsigned long long)st->st_ino);
+	ir_put_varint(key, strlen(filename));
+	strbuf_append(key, filename);
+}
+
+static char *cache_path(const char *dir, STRBUF *key)
+{
+	size_t len = strlen(dir) + 32;
+	char *path = ymalloc(len);
+
+	snprintf(path, len, "%s/%08x.ir", dir, strbuf_crc32(key));
+	return path;
+}
+
+STRBUF *ir_cache_load(const char *dir, const char *filename,
+		      const struct stat *st)
+{
+	STRBUF *key = strbuf_new();
+	STRBUF *ir = NULL;
+	char *path;
+	char readbuf[4096];
+	ssize_t r;
+	int fd;
+
+	strbuf_setopt(key, STRBUF_NULLOK);
+	cache_key(key, filename, st);
+	path = cache_path(dir, key);
+
+	fd = open(path, O_RDONLY);
+	if (fd != -1) {
+		ir = strbuf_new();
+		strbuf_setopt(ir, STRBUF_NULLOK);
+		while ((r = read(fd, readbuf, sizeof(readbuf))) > 0)
+			strbuf_append_n(ir, readbuf, (size_t)r);
+		close(fd);
+
+		if (r == -1 || strbuf_len(ir) < strbuf_len(key) ||
+		    memcmp(strbuf_get(ir), strbuf_get(key), strbuf_len(key))) {
+			strbuf_free(ir);
+			ir = NULL;
+		} else {
+			strbuf_subst(ir, 0, strbuf_len(key), "");
+		}
+	}
+
+	yfree(path);
+	strbuf_free(key);
+	return ir;
+}
+
+void ir_cache_store(const char *dir, const char *filename,
+		    const struct stat *st, STRBUF *ir)
+{
+	STRBUF *key = strbuf_new();
+	char *path, *tmp;
+	size_t len;
+	int fd;
+
+	strbuf_setopt(key, STRBUF_NULLOK);
+	cache_key(key, filename, st);
+	path = cache_path(dir, key);
+
+	/* write to a private file first, concurrent readers must
+	   never see a partial entry */
+	len = strlen(path) + 32;
+	tmp = ymalloc(len);
+	snprintf(tmp, len, "%s.%ld", path, (long)getpid());
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd != -1) {
+		int ok = write(fd, strbuf_get(key), strbuf_len(key))
+				== (ssize_t)strbuf_len(key)
+			&& write(fd, strbuf_get(ir), strbuf_len(ir))
+				== (ssize_t)strbuf_len(ir);
+
+		if (close(fd) == 0 && ok && rename(tmp, path) == 0) {
+			yfree(tmp);
+			tmp = NULL;
+		}
+	}
+	if (tmp) {
+		fprintf(stderr, "warning: Can't write cache entry %s: %s\n",
+			path, strerror(errno));
+		unlink(tmp);
+		yfree(tmp);
+	}
+
+	yfree(path);
+	strbuf_free(key);
+}
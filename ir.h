@@ -0,0 +1,78 @@
+/*
+ * ir.c: A compact intermediate representation of formatted documents
+ *
+ * Copyright (c) 2006-2009 Dennis Stosberg <dennis@stosberg.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2 as published by the Free Software Foundation
+ */
+
+#ifndef IR_H
+#define IR_H
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "strbuf.h"
+
+/*
+ * Headlines are kept out of the text until the output encoding is
+ * known, because their underline depends on the substitutions made.
+ * A marked headline is IR_MARK, '=' or '-', the headline text and
+ * IR_MARK_END.
+ */
+#define IR_MARK     '\001'
+#define IR_MARK_END '\002'
+
+/*
+ * Record types.  Every record is one type byte, a varint length and
+ * length bytes of text.  IR_BREAK carries the number of newlines in
+ * the length field and no text.
+ */
+enum ir_record {
+	IR_END   = 0,
+	IR_TEXT  = 1,  /* a run of text without newlines */
+	IR_BREAK = 2,  /* one newline is a line break, more a paragraph */
+	IR_H1    = 3,  /* headline of the first level */
+	IR_H2    = 4   /* other headlines */
+};
+
+/*
+ * Appends v to buf as a varint of seven bits per byte, least
+ * significant first.
+ */
+void ir_put_varint(STRBUF *buf, unsigned long long v);
+
+/*
+ * Reads a varint at *p and advances *p past it.  Returns -1 if it
+ * runs past end.
+ */
+int ir_get_varint(const char **p, const char *end, unsigned long long *v);
+
+/*
+ * Encodes a formatted document with marked headlines into records.
+ */
+STRBUF *ir_encode(STRBUF *doc);
+
+/*
+ * Decodes records back into a formatted document with marked
+ * headlines.  Returns NULL if ir is corrupted.
+ */
+STRBUF *ir_decode(STRBUF *ir);
+
+/*
+ * Loads the records for filename from the cache directory dir.
+ * Returns NULL if there is no entry or if it is stale.
+ */
+STRBUF *ir_cache_load(const char *dir, const char *filename,
+		      const struct stat *st);
+
+/*
+ * Stores the records for filename in the cache directory dir.
+ * Failing to write the cache is not an error.
+ */
+void ir_cache_store(const char *dir, const char *filename,
+		    const struct stat *st, STRBUF *ir);
+
+#endif /* IR_H */
@@ -18,6 +18,18 @@ STRBUF *kunzip_next_tobuf(char *zip_filename, int offset);
 
 /*
 
+kunzip_next_tobuf_cb - Like kunzip_next_tobuf, but calls fn whenever
+                    data has been appended to the buffer.  See
+                    strbuf_append_inflate_cb.  The checksum is not
+                    verified.
+
+*/
+
+STRBUF *kunzip_next_tobuf_cb(char *zip_filename, int offset,
+			     strbuf_inflate_fn fn, void *data);
+
+/*
+
 kunzip_get_offset_by_name - Search through a zip archive for a filename
                     that either partially or exactly matches.  If offset
                     is set to -1, the search will start at the start of
@@ -27,7 +27,8 @@ version 2 as published by the Free Software Foundation
 
 /* #define _GNU_SOURCE */
 
-unsigned int copy_file_tobuf(FILE *in, STRBUF *out, int len)
+unsigned int copy_file_tobuf(FILE *in, STRBUF *out, int len,
+			     strbuf_inflate_fn fn, void *data)
 {
 	unsigned char buffer[BUFFER_SIZE];
 	uLong checksum;
@@ -48,6 +49,9 @@ unsigned int copy_file_tobuf(FILE *in, STRBUF *out, int len)
 		strbuf_append_n(out, (char *)buffer, r);
 		checksum = crc32(checksum, buffer, r);
 		t = t + r;
+
+		if (fn && fn(out, data))
+			break;
 	}
 
 	return checksum;
@@ -137,7 +141,7 @@ int print_zip_header(struct zip_local_file_header_t *local_file_header)
 }
 #endif
 
-STRBUF *kunzip_file_tobuf(FILE *in)
+STRBUF *kunzip_file_tobuf(FILE *in, strbuf_inflate_fn fn, void *data)
 {
 	STRBUF *out;
 	struct zip_local_file_header_t local_file_header;
@@ -171,16 +175,18 @@ STRBUF *kunzip_file_tobuf(FILE *in)
 	if (local_file_header.compression_method == 0) {
 		checksum =
 			copy_file_tobuf(in, out,
-					local_file_header.uncompressed_size);
+					local_file_header.uncompressed_size,
+					fn, data);
 	} else if (local_file_header.compression_method == Z_DEFLATED) {
-		(void)strbuf_append_inflate(out, in);
+		(void)strbuf_append_inflate_cb(out, in, fn, data);
 		checksum = strbuf_crc32(out);
 	} else {
 		fprintf(stderr, "Unknown compression method\n");
 		exit(EXIT_FAILURE);
 	}
 
-	if ((unsigned int)checksum != local_file_header.crc_32
+	/* fn may have consumed data or stopped early */
+	if (!fn && (unsigned int)checksum != local_file_header.crc_32
 	    && local_file_header.crc_32 != 0) {
 		fprintf(stderr,
 			"Warning: Checksum does not match: %d %d.\nPossibly the file"
@@ -204,6 +210,12 @@ STRBUF *kunzip_file_tobuf(FILE *in)
 }
 
 STRBUF *kunzip_next_tobuf(char *zip_filename, int offset)
+{
+	return kunzip_next_tobuf_cb(zip_filename, offset, NULL, NULL);
+}
+
+STRBUF *kunzip_next_tobuf_cb(char *zip_filename, int offset,
+			     strbuf_inflate_fn fn, void *data)
 {
 	FILE *in;
 	STRBUF *buf;
@@ -216,7 +228,7 @@ STRBUF *kunzip_next_tobuf(char *zip_filename, int offset)
 
 	fseek(in, offset, SEEK_SET);
 
-	buf = kunzip_file_tobuf(in);
+	buf = kunzip_file_tobuf(in, fn, data);
 	marker = ftell(in);
 	fclose(in);
 
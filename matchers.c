@@ -0,0 +1,589 @@
+/* Generated by tools/genmatch.  Do not edit. */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "matchers.h"
+
+/* "^\012+" */
+static int rx_at0(const char *s, const char *p, const char *end,
+		   regmatch_t m[])
+{
+	const char *q;
+
+	for (q = p; q < end && (*q == '\012'); q++)
+		;
+	if (q - p < 1)
+		return 0;
+	p = q;
+	m[0].rm_eo = p - s;
+	return 1;
+}
+
+static int rx_match0(const char *s, size_t len, regmatch_t m[],
+		      size_t nmatch)
+{
+	const char *end = s + len;
+	const char *p = s;
+	regmatch_t g[1];
+	size_t i;
+
+	if (!rx_at0(s, p, end, g))
+		return 0;
+	g[0].rm_so = p - s;
+
+	for (i = 0; i < nmatch; i++) {
+		if (i < 1) {
+			m[i] = g[i];
+		} else {
+			m[i].rm_so = -1;
+			m[i].rm_eo = -1;
+		}
+	}
+	return 1;
+}
+
+/* "\012{2,}$" */
+static int rx_at1(const char *s, const char *p, const char *end,
+		   regmatch_t m[])
+{
+	const char *q;
+
+	for (q = p; q < end && (*q == '\012'); q++)
+		;
+	if (q - p < 2)
+		return 0;
+	p = q;
+	if (p != end)
+		return 0;
+	m[0].rm_eo = p - s;
+	return 1;
+}
+
+static int rx_match1(const char *s, size_t len, regmatch_t m[],
+		      size_t nmatch)
+{
+	const char *end = s + len;
+	const char *p = s;
+	regmatch_t g[1];
+	size_t i;
+
+	for (;; p++) {
+		if (rx_at1(s, p, end, g))
+			break;
+		if (p == end)
+			return 0;
+	}
+	g[0].rm_so = p - s;
+
+	for (i = 0; i < nmatch; i++) {
+		if (i < 1) {
+			m[i] = g[i];
+		} else {
+			m[i].rm_so = -1;
+			m[i].rm_eo = -1;
+		}
+	}
+	return 1;
+}
+
+/* "\012 +" */
+static int rx_at2(const char *s, const char *p, const char *end,
+		   regmatch_t m[])
+{
+	const char *q;
+
+	if (p == end || *p != '\012')
+		return 0;
+	p += 1;
+	for (q = p; q < end && (*q == ' '); q++)
+		;
+	if (q - p < 1)
+		return 0;
+	p = q;
+	m[0].rm_eo = p - s;
+	return 1;
+}
+
+static int rx_match2(const char *s, size_t len, regmatch_t m[],
+		      size_t nmatch)
+{
+	const char *end = s + len;
+	const char *p = s;
+	regmatch_t g[1];
+	size_t i;
+
+	for (;; p++) {
+		p = memchr(p, '\012', (size_t)(end - p));
+		if (!p)
+			return 0;
+		if (rx_at2(s, p, end, g))
+			break;
+	}
+	g[0].rm_so = p - s;
+
+	for (i = 0; i < nmatch; i++) {
+		if (i < 1) {
+			m[i] = g[i];
+		} else {
+			m[i].rm_so = -1;
+			m[i].rm_eo = -1;
+		}
+	}
+	return 1;
+}
+
+/* "\012{3,}" */
+static int rx_at3(const char *s, const char *p, const char *end,
+		   regmatch_t m[])
+{
+	const char *q;
+
+	for (q = p; q < end && (*q == '\012'); q++)
+		;
+	if (q - p < 3)
+		return 0;
+	p = q;
+	m[0].rm_eo = p - s;
+	return 1;
+}
+
+static int rx_match3(const char *s, size_t len, regmatch_t m[],
+		      size_t nmatch)
+{
+	const char *end = s + len;
+	const char *p = s;
+	regmatch_t g[1];
+	size_t i;
+
+	for (;; p++) {
+		if (rx_at3(s, p, end, g))
+			break;
+		if (p == end)
+			return 0;
+	}
+	g[0].rm_so = p - s;
+
+	for (i = 0; i < nmatch; i++) {
+		if (i < 1) {
+			m[i] = g[i];
+		} else {
+			m[i].rm_so = -1;
+			m[i].rm_eo = -1;
+		}
+	}
+	return 1;
+}
+
+/* "&apos;" */
+static int rx_at4(const char *s, const char *p, const char *end,
+		   regmatch_t m[])
+{
+
+	if ((size_t)(end - p) < 6 || memcmp(p, "&apos;", 6))
+		return 0;
+	p += 6;
+	m[0].rm_eo = p - s;
+	return 1;
+}
+
+static int rx_match4(const char *s, size_t len, regmatch_t m[],
+		      size_t nmatch)
+{
+	const char *end = s + len;
+	const char *p = s;
+	regmatch_t g[1];
+	size_t i;
+
+	for (;; p++) {
+		p = memchr(p, '&', (size_t)(end - p));
+		if (!p)
+			return 0;
+		if (rx_at4(s, p, end, g))
+			break;
+	}
+	g[0].rm_so = p - s;
+
+	for (i = 0; i < nmatch; i++) {
+		if (i < 1) {
+			m[i] = g[i];
+		} else {
+			m[i].rm_so = -1;
+			m[i].rm_eo = -1;
+		}
+	}
+	return 1;
+}
+
+/* "&amp;" */
+static int rx_at5(const char *s, const char *p, const char *end,
+		   regmatch_t m[])
+{
+
+	if ((size_t)(end - p) < 5 || memcmp(p, "&amp;", 5))
+		return 0;
+	p += 5;
+	m[0].rm_eo = p - s;
+	return 1;
+}
+
+static int rx_match5(const char *s, size_t len, regmatch_t m[],
+		      size_t nmatch)
+{
+	const char *end = s + len;
+	const char *p = s;
+	regmatch_t g[1];
+	size_t i;
+
+	for (;; p++) {
+		p = memchr(p, '&', (size_t)(end - p));
+		if (!p)
+			return 0;
+		if (rx_at5(s, p, end, g))
+			break;
+	}
+	g[0].rm_so = p - s;
+
+	for (i = 0; i < nmatch; i++) {
+		if (i < 1) {
+			m[i] = g[i];
+		} else {
+			m[i].rm_so = -1;
+			m[i].rm_eo = -1;
+		}
+	}
+	return 1;
+}
+
+/* "&quot;" */
+static int rx_at6(const char *s, const char *p, const char *end,
+		   regmatch_t m[])
+{
+
+	if ((size_t)(end - p) < 6 || memcmp(p, "&quot;", 6))
+		return 0;
+	p += 6;
+	m[0].rm_eo = p - s;
+	return 1;
+}
+
+static int rx_match6(const char *s, size_t len, regmatch_t m[],
+		      size_t nmatch)
+{
+	const char *end = s + len;
+	const char *p = s;
+	regmatch_t g[1];
+	size_t i;
+
+	for (;; p++) {
+		p = memchr(p, '&', (size_t)(end - p));
+		if (!p)
+			return 0;
+		if (rx_at6(s, p, end, g))
+			break;
+	}
+	g[0].rm_so = p - s;
+
+	for (i = 0; i < nmatch; i++) {
+		if (i < 1) {
+			m[i] = g[i];
+		} else {
+			m[i].rm_so = -1;
+			m[i].rm_eo = -1;
+		}
+	}
+	return 1;
+}
+
+/* "&gt;" */
+static int rx_at7(const char *s, const char *p, const char *end,
+		   regmatch_t m[])
+{
+
+	if ((size_t)(end - p) < 4 || memcmp(p, "&gt;", 4))
+		return 0;
+	p += 4;
+	m[0].rm_eo = p - s;
+	return 1;
+}
+
+static int rx_match7(const char *s, size_t len, regmatch_t m[],
+		      size_t nmatch)
+{
+	const char *end = s + len;
+	const char *p = s;
+	regmatch_t g[1];
+	size_t i;
+
+	for (;; p++) {
+		p = memchr(p, '&', (size_t)(end - p));
+		if (!p)
+			return 0;
+		if (rx_at7(s, p, end, g))
+			break;
+	}
+	g[0].rm_so = p - s;
+
+	for (i = 0; i < nmatch; i++) {
+		if (i < 1) {
+			m[i] = g[i];
+		} else {
+			m[i].rm_so = -1;
+			m[i].rm_eo = -1;
+		}
+	}
+	return 1;
+}
+
+/* "&lt;" */
+static int rx_at8(const char *s, const char *p, const char *end,
+		   regmatch_t m[])
+{
+
+	if ((size_t)(end - p) < 4 || memcmp(p, "&lt;", 4))
+		return 0;
+	p += 4;
+	m[0].rm_eo = p - s;
+	return 1;
+}
+
+static int rx_match8(const char *s, size_t len, regmatch_t m[],
+		      size_t nmatch)
+{
+	const char *end = s + len;
+	const char *p = s;
+	regmatch_t g[1];
+	size_t i;
+
+	for (;; p++) {
+		p = memchr(p, '&', (size_t)(end - p));
+		if (!p)
+			return 0;
+		if (rx_at8(s, p, end, g))
+			break;
+	}
+	g[0].rm_so = p - s;
+
+	for (i = 0; i < nmatch; i++) {
+		if (i < 1) {
+			m[i] = g[i];
+		} else {
+			m[i].rm_so = -1;
+			m[i].rm_eo = -1;
+		}
+	}
+	return 1;
+}
+
+/* "\001[=-]\002" */
+static const unsigned char rx_set0[256] = {
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+};
+
+static int rx_at9(const char *s, const char *p, const char *end,
+		   regmatch_t m[])
+{
+
+	if (p == end || *p != '\001')
+		return 0;
+	p += 1;
+	if (p == end || !(rx_set0[(unsigned char)*p]))
+		return 0;
+	p++;
+	if (p == end || *p != '\002')
+		return 0;
+	p += 1;
+	m[0].rm_eo = p - s;
+	return 1;
+}
+
+static int rx_match9(const char *s, size_t len, regmatch_t m[],
+		      size_t nmatch)
+{
+	const char *end = s + len;
+	const char *p = s;
+	regmatch_t g[1];
+	size_t i;
+
+	for (;; p++) {
+		p = memchr(p, '\001', (size_t)(end - p));
+		if (!p)
+			return 0;
+		if (rx_at9(s, p, end, g))
+			break;
+	}
+	g[0].rm_so = p - s;
+
+	for (i = 0; i < nmatch; i++) {
+		if (i < 1) {
+			m[i] = g[i];
+		} else {
+			m[i].rm_so = -1;
+			m[i].rm_eo = -1;
+		}
+	}
+	return 1;
+}
+
+/* "<text:h[^>]*outline-level=\"1\"[^>]*>([^<]*)<[^>]*>" */
+static int rx_at10(const char *s, const char *p, const char *end,
+		   regmatch_t m[])
+{
+	const char *g1;
+	const char *q;
+	const char *start7;
+	ptrdiff_t n7;
+
+	if ((size_t)(end - p) < 7 || memcmp(p, "<text:h", 7))
+		return 0;
+	p += 7;
+	for (q = p; q < end && (*q != '>'); q++)
+		;
+	start7 = p;
+	for (n7 = q - p; n7 >= 0; n7--) {
+		p = start7 + n7;
+		if (p == end || !(*p == 'o'))
+			continue;
+		if ((size_t)(end - p) < 17 || memcmp(p, "outline-level=\"1\"", 17))
+			continue;
+		p += 17;
+		for (q = p; q < end && (*q != '>'); q++)
+			;
+		p = q;
+		if (p == end || *p != '>')
+			continue;
+		p += 1;
+		g1 = p;
+		for (q = p; q < end && (*q != '<'); q++)
+			;
+		p = q;
+		m[1].rm_so = g1 - s;
+		m[1].rm_eo = p - s;
+		if (p == end || *p != '<')
+			continue;
+		p += 1;
+		for (q = p; q < end && (*q != '>'); q++)
+			;
+		p = q;
+		if (p == end || *p != '>')
+			continue;
+		p += 1;
+		m[0].rm_eo = p - s;
+		return 1;
+	}
+	return 0;
+}
+
+static int rx_match10(const char *s, size_t len, regmatch_t m[],
+		      size_t nmatch)
+{
+	const char *end = s + len;
+	const char *p = s;
+	regmatch_t g[2];
+	size_t i;
+
+	for (;; p++) {
+		p = memchr(p, '<', (size_t)(end - p));
+		if (!p)
+			return 0;
+		if (rx_at10(s, p, end, g))
+			break;
+	}
+	g[0].rm_so = p - s;
+
+	for (i = 0; i < nmatch; i++) {
+		if (i < 2) {
+			m[i] = g[i];
+		} else {
+			m[i].rm_so = -1;
+			m[i].rm_eo = -1;
+		}
+	}
+	return 1;
+}
+
+/* "<text:h[^>]*>([^<]*)<[^>]*>" */
+static int rx_at11(const char *s, const char *p, const char *end,
+		   regmatch_t m[])
+{
+	const char *g1;
+	const char *q;
+
+	if ((size_t)(end - p) < 7 || memcmp(p, "<text:h", 7))
+		return 0;
+	p += 7;
+	for (q = p; q < end && (*q != '>'); q++)
+		;
+	p = q;
+	if (p == end || *p != '>')
+		return 0;
+	p += 1;
+	g1 = p;
+	for (q = p; q < end && (*q != '<'); q++)
+		;
+	p = q;
+	m[1].rm_so = g1 - s;
+	m[1].rm_eo = p - s;
+	if (p == end || *p != '<')
+		return 0;
+	p += 1;
+	for (q = p; q < end && (*q != '>'); q++)
+		;
+	p = q;
+	if (p == end || *p != '>')
+		return 0;
+	p += 1;
+	m[0].rm_eo = p - s;
+	return 1;
+}
+
+static int rx_match11(const char *s, size_t len, regmatch_t m[],
+		      size_t nmatch)
+{
+	const char *end = s + len;
+	const char *p = s;
+	regmatch_t g[2];
+	size_t i;
+
+	for (;; p++) {
+		p = memchr(p, '<', (size_t)(end - p));
+		if (!p)
+			return 0;
+		if (rx_at11(s, p, end, g))
+			break;
+	}
+	g[0].rm_so = p - s;
+
+	for (i = 0; i < nmatch; i++) {
+		if (i < 2) {
+			m[i] = g[i];
+		} else {
+			m[i].rm_so = -1;
+			m[i].rm_eo = -1;
+		}
+	}
+	return 1;
+}
+
+const struct matcher matchers[] = {
+	{ "^\012+", rx_match0 },
+	{ "\012{2,}$", rx_match1 },
+	{ "\012 +", rx_match2 },
+	{ "\012{3,}", rx_match3 },
+	{ "&apos;", rx_match4 },
+	{ "&amp;", rx_match5 },
+	{ "&quot;", rx_match6 },
+	{ "&gt;", rx_match7 },
+	{ "&lt;", rx_match8 },
+	{ "\001[=-]\002", rx_match9 },
+	{ "<text:h[^>]*outline-level=\"1\"[^>]*>([^<]*)<[^>]*>", rx_match10 },
+	{ "<text:h[^>]*>([^<]*)<[^>]*>", rx_match11 },
+	{ NULL, NULL }
+};
@@ -0,0 +1,43 @@
+/*
+ * matchers.h: Matchers for fixed regular expressions, generated at
+ *             build time by tools/genmatch
+ *
+ * Copyright (c) 2006-2009 Dennis Stosberg <dennis@stosberg.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2 as published by the Free Software Foundation
+ */
+
+#ifndef MATCHERS_H
+#define MATCHERS_H
+
+#include <regex.h>
+#include <stddef.h>
+
+/*
+ * Finds the first match of a fixed pattern in s[0..len), like
+ * regexec with REG_STARTEND.  Returns 1 on a match and fills in
+ * nmatch entries of m, 0 otherwise.
+ */
+typedef int (*matcher_fn)(const char *s, size_t len, regmatch_t m[],
+			  size_t nmatch);
+
+struct matcher {
+	const char *regex;
+	matcher_fn match;
+};
+
+/*
+ * One entry for every pattern in the sources, terminated by an entry
+ * whose regex is NULL.
+ */
+extern const struct matcher matchers[];
+
+/*
+ * Returns the generated matcher for regex, or NULL if regex has to
+ * be compiled by regcomp.
+ */
+matcher_fn matcher_find(const char *regex);
+
+#endif /* MATCHERS_H */
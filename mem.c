@@ -8,8 +8,94 @@
  * version 2 as published by the Free Software Foundation
  */
 
+#ifndef NO_THREADS
+#  include <pthread.h>
+#endif
+
 #include "mem.h"
 
+#ifdef NO_THREADS
+static const struct allocator *the_allocator;
+#else
+static pthread_key_t allocator_key;
+static pthread_once_t allocator_once = PTHREAD_ONCE_INIT;
+
+static void allocator_key_create(void)
+{
+	if (pthread_key_create(&allocator_key, NULL)) {
+		fprintf(stderr, "Can't create allocator key\n");
+		exit(EXIT_FAILURE);
+	}
+}
+#endif
+
+/* the allocator of the calling thread, NULL for the C library */
+const struct allocator *mem_allocator(void)
+{
+#ifdef NO_THREADS
+	return the_allocator;
+#else
+	(void)pthread_once(&allocator_once, allocator_key_create);
+	return pthread_getspecific(allocator_key);
+#endif
+}
+
+const struct allocator *mem_set_allocator(const struct allocator *a)
+{
+	const struct allocator *old = mem_allocator();
+
+#ifdef NO_THREADS
+	the_allocator = a;
+#else
+	if (pthread_setspecific(allocator_key, a)) {
+		fprintf(stderr, "Can't set allocator\n");
+		exit(EXIT_FAILURE);
+	}
+#endif
+	return old;
+}
+
+void *mem_malloc(size_t size)
+{
+	const struct allocator *a = mem_allocator();
+
+	return a ? a->malloc_fn(a->ctx, size) : malloc(size);
+}
+
+void *mem_calloc(size_t number, size_t size)
+{
+	const struct allocator *a = mem_allocator();
+	void *p;
+
+	if (!a)
+		return calloc(number, size);
+	if (size && number > (size_t)-1 / size)
+		return NULL;
+	p = a->malloc_fn(a->ctx, number * size);
+	if (p)
+		memset(p, 0, number * size);
+	return p;
+}
+
+void *mem_realloc(void *p, size_t size)
+{
+	const struct allocator *a = mem_allocator();
+
+	if (!a)
+		return realloc(p, size);
+	return p ? a->realloc_fn(a->ctx, p, size) : a->malloc_fn(a->ctx, size);
+}
+
+void mem_free(void *p)
+{
+	const struct allocator *a = mem_allocator();
+
+	if (!a)
+		free(p);
+	else if (p)
+		a->free_fn(a->ctx, p);
+}
+
 #ifdef MEMDEBUG
 static void    meminfo_add(void *p, size_t size, const char *file, int line);
 static void    meminfo_rm(void *p, const char *file, int line);
@@ -156,7 +242,7 @@ void *ymalloc_dbg(size_t size, const char *file, int line) {
 	if(!size)
 		die("Trying to allocate 0 bytes at %s:%d", file, line);
 
-	p = malloc(size + 2*sizeof(magic));
+	p = mem_malloc(size + 2*sizeof(magic));
 	if(!p)
 		die("Out of memory at %s:%d while trying to allocate %lu bytes",
 		    file, line, (unsigned long)size);
@@ -195,7 +281,7 @@ void yfree_dbg(void *p, const char *file, int line) {
 		    "overwritten.", info->file, info->line);
 	}
 
-	free((char*)p - sizeof(magic));
+	mem_free((char*)p - sizeof(magic));
 	meminfo_rm((char*)p - sizeof(magic), file, line);
 
 	p = NULL;
@@ -242,7 +328,7 @@ void *yrealloc_dbg(void *p, size_t size, const char *file, int line) {
 	}
 
 	meminfo_rm((char*)p - sizeof(magic), file, line);
-	p = realloc((char*)p - sizeof(magic), size + 2*sizeof(magic));
+	p = mem_realloc((char*)p - sizeof(magic), size + 2*sizeof(magic));
 
 	if(!p)
 		die("Out of memory at %s:%d while trying to allocate %lu bytes",
@@ -17,6 +17,39 @@
 #include <stdarg.h>
 #include <assert.h>
 
+/*
+ * An allocator for ymalloc, ycalloc, yrealloc and yfree, e.g. an
+ * arena or one that accounts for the memory of an embedder.  ctx is
+ * passed to every call.  realloc_fn and free_fn are only given blocks
+ * which came from the same allocator.
+ */
+struct allocator {
+	void *(*malloc_fn)(void *ctx, size_t size);
+	void *(*realloc_fn)(void *ctx, void *p, size_t size);
+	void (*free_fn)(void *ctx, void *p);
+	void *ctx;
+};
+
+/*
+ * Makes `a` the allocator of the calling thread, or the C library if `a`
+ * is NULL, and returns the previous one.  Threads start with the C
+ * library.  A conversion uses the allocator of the thread it runs on,
+ * and its helper threads take it over.
+ *
+ * Memory must go back to the allocator it came from.  Before the
+ * allocator of a thread is changed back, the results of the
+ * conversion have to be freed and the buffer pool flushed with
+ * strbuf_pool_flush.  Very large buffers may be mapped with mmap
+ * instead, see strbuf.c.
+ */
+const struct allocator *mem_set_allocator(const struct allocator *a);
+const struct allocator *mem_allocator(void);
+
+void *mem_malloc(size_t size);
+void *mem_calloc(size_t number, size_t size);
+void *mem_realloc(void *p, size_t size);
+void mem_free(void *p);
+
 #ifdef MEMDEBUG
 
 /**
@@ -35,17 +68,17 @@ void yfree_dbg(void *p, const char *file, int line);
 #define ymalloc(size) ymalloc_dbg(size, __FILE__, __LINE__)
 void *ymalloc_dbg(size_t size, const char *file, int line);
 
-#define ycalloc(num, size) ymalloc_dbg(num, size, __FILE__, __LINE__)
+#define ycalloc(num, size) ycalloc_dbg(num, size, __FILE__, __LINE__)
 void *ycalloc_dbg(size_t number, size_t size, const char *file, int line);
 
 #define yrealloc(p, size) yrealloc_dbg(p, size, __FILE__, __LINE__)
 void *yrealloc_dbg(void *p, size_t size, const char *file, int line);
 
 #else
-#define yfree(p)           free(p)
-#define ymalloc(size)      malloc(size)
-#define ycalloc(num, size) calloc(num, size);
-#define yrealloc(p, size)  realloc(p, size);
+#define yfree(p)           mem_free(p)
+#define ymalloc(size)      mem_malloc(size)
+#define ycalloc(num, size) mem_calloc(num, size)
+#define yrealloc(p, size)  mem_realloc(p, size)
 #endif
 
 #endif /* MEM_H */
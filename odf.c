@@ -0,0 +1,51 @@
+/*
+ * odf.c: Classification of the elements of OpenDocument XML
+ *
+ * Copyright (c) 2006-2009 Dennis Stosberg <dennis@stosberg.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2 as published by the Free Software Foundation
+ */
+
+#include <string.h>
+
+#include "odf.h"
+
+static int is_name_end(char c)
+{
+	return c == ' ' || c == '/' || c == '>' ||
+		c == '\t' || c == '\n' || c == '\r';
+}
+
+int odf_next_tag(const char *p, const char *end, struct odf_tag *tag)
+{
+	const char *gt, *q;
+
+	p = memchr(p, '<', (size_t)(end - p));
+	if (!p)
+		return 0;
+	gt = memchr(p, '>', (size_t)(end - p));
+	if (!gt)
+		return 0;
+
+	tag->start = p;
+	tag->end = gt + 1;
+	tag->closing = p[1] == '/';
+	tag->empty = gt[-1] == '/' && gt - 1 > p;
+
+	q = tag->name = p + 1 + tag->closing;
+	while (q < gt && !is_name_end(*q))
+		q++;
+	tag->name_len = (size_t)(q - tag->name);
+	tag->elem = odf_element(tag->name, tag->name_len);
+
+	return 1;
+}
+
+int odf_tag_is(const struct odf_tag *tag, const char *s)
+{
+	size_t len = (size_t)(tag->end - tag->start);
+
+	return strlen(s) == len && !memcmp(tag->start, s, len);
+}
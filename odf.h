@@ -0,0 +1,85 @@
+/*
+ * odf.h: Classification of the elements of OpenDocument XML
+ *
+ * Copyright (c) 2006-2009 Dennis Stosberg <dennis@stosberg.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2 as published by the Free Software Foundation
+ */
+
+#ifndef ODF_H
+#define ODF_H
+
+#include <stddef.h>
+
+/*
+ * The elements odt2txt knows by name.  tools/genelem builds a perfect
+ * hash table over this list at build time, see elements.c.
+ */
+#define ODF_ELEMENTS \
+	ODF_ELEMENT(OFFICE_BODY,          "office:body")          \
+	ODF_ELEMENT(OFFICE_TEXT,          "office:text")          \
+	ODF_ELEMENT(OFFICE_PRESENTATION,  "office:presentation")  \
+	ODF_ELEMENT(TEXT_P,               "text:p")               \
+	ODF_ELEMENT(TEXT_H,               "text:h")               \
+	ODF_ELEMENT(TEXT_SPAN,            "text:span")            \
+	ODF_ELEMENT(TEXT_A,               "text:a")               \
+	ODF_ELEMENT(TEXT_TAB,             "text:tab")             \
+	ODF_ELEMENT(TEXT_S,               "text:s")               \
+	ODF_ELEMENT(TEXT_LINE_BREAK,      "text:line-break")      \
+	ODF_ELEMENT(TEXT_SOFT_PAGE_BREAK, "text:soft-page-break") \
+	ODF_ELEMENT(TEXT_LIST,            "text:list")            \
+	ODF_ELEMENT(TEXT_LIST_ITEM,       "text:list-item")       \
+	ODF_ELEMENT(TEXT_NOTE,            "text:note")            \
+	ODF_ELEMENT(TEXT_NOTE_BODY,       "text:note-body")       \
+	ODF_ELEMENT(TEXT_BOOKMARK,        "text:bookmark")        \
+	ODF_ELEMENT(TEXT_SEQUENCE_DECLS,  "text:sequence-decls")  \
+	ODF_ELEMENT(TEXT_SECTION,         "text:section")         \
+	ODF_ELEMENT(TABLE_TABLE,          "table:table")          \
+	ODF_ELEMENT(TABLE_TABLE_COLUMN,   "table:table-column")   \
+	ODF_ELEMENT(TABLE_TABLE_ROW,      "table:table-row")      \
+	ODF_ELEMENT(TABLE_TABLE_CELL,     "table:table-cell")     \
+	ODF_ELEMENT(DRAW_PAGE,            "draw:page")            \
+	ODF_ELEMENT(DRAW_FRAME,           "draw:frame")           \
+	ODF_ELEMENT(DRAW_IMAGE,           "draw:image")           \
+	ODF_ELEMENT(DRAW_TEXT_BOX,        "draw:text-box")        \
+	ODF_ELEMENT(DRAW_OBJECT,          "draw:object")          \
+	ODF_ELEMENT(PRESENTATION_NOTES,   "presentation:notes")
+
+enum odf_element {
+	ODF_UNKNOWN,
+#define ODF_ELEMENT(id, name) ODF_##id,
+	ODF_ELEMENTS
+#undef ODF_ELEMENT
+	ODF_NUM_ELEMENTS
+};
+
+/*
+ * Returns the element called name[0..len), or ODF_UNKNOWN.  It takes
+ * one hash and one comparison.  Generated, see tools/genelem.c.
+ */
+enum odf_element odf_element(const char *name, size_t len);
+
+struct odf_tag {
+	const char *start;      /* the '<' */
+	const char *end;        /* after the '>' */
+	const char *name;
+	size_t name_len;
+	enum odf_element elem;
+	int closing;            /* </name> */
+	int empty;              /* <name/> */
+};
+
+/*
+ * Finds the next tag in p[0..end), which runs from a '<' to the first
+ * '>' after it.  Returns 1 and fills in tag, or 0 if there is none.
+ */
+int odf_next_tag(const char *p, const char *end, struct odf_tag *tag);
+
+/*
+ * Returns 1 if the tag is exactly the text s, e.g. "<text:tab/>".
+ */
+int odf_tag_is(const struct odf_tag *tag, const char *s);
+
+#endif /* ODF_H */
@@ -12,6 +12,8 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #ifdef NO_ICONV
@@ -27,15 +29,26 @@
 
 #include <limits.h>
 #include <locale.h>
+#ifndef NO_THREADS
+#  include <pthread.h>
+#endif
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "charset.h"
+#include "ir.h"
 #include "mem.h"
+#include "odf.h"
+#include "paraidx.h"
+#ifndef NO_FORK
+#include "pool.h"
+#endif
 #include "regex.h"
 #include "strbuf.h"
+#include "trace.h"
 #ifdef HAVE_LIBZIP
 #  include <zip.h>
 #else
@@ -47,8 +60,28 @@
 static int opt_raw;
 static char *opt_encoding;
 static int opt_width = 63;
-static const char *opt_filename;
+static const char **opt_filenames;
+static size_t opt_num_filenames;
+static size_t opt_filenames_size;
 static char *opt_output;
+static int opt_jobs;
+static char *opt_cache;
+static size_t opt_chunk_size;
+static char *opt_grep;
+static int opt_count;
+static int opt_first;
+static int opt_stats;
+static int opt_index;
+static char *opt_lookup;
+static size_t opt_range_first;
+static size_t opt_range_last;
+static int opt_range_headlines;
+static int opt_profile;
+static int opt_slides;
+static int opt_objects;
+static int conv_threads = 1;
+static unsigned long doc_id;  /* the document in progress, see trace.h */
+static RX *grep_rx;
 
 #define SUBST_NONE 0
 #define SUBST_SOME 1
@@ -56,6 +89,25 @@ static char *opt_output;
 
 static int opt_subst = SUBST_SOME;
 
+/*
+ * An output target.  All targets share reading and formatting of a
+ * document; they differ only in wrapping and conversion.
+ */
+struct target {
+	char *encoding;
+	int width;
+	int subst;
+	char *output;
+	const struct charset *cs;  /* NULL if converted by iconv */
+	iconv_t ic;
+	int same;                  /* output is the UTF-8 text itself */
+	int fd;
+	STRBUF *index;             /* with --index, see render_index */
+};
+
+static struct target *targets;
+static size_t num_targets;
+
 #ifndef ICONV_CHAR
 #define ICONV_CHAR char
 #endif
@@ -64,12 +116,141 @@ static int opt_subst = SUBST_SOME;
 static void show_iconvlist();
 #endif
 
-#define RS_O(a,b) (void)regex_subst(buf, (a), _REG_DEFAULT, (b))
-#define RS_G(a,b) (void)regex_subst(buf, (a), _REG_GLOBAL, (b))
-#define RS_E(a,b) (void)regex_subst(buf, (a), _REG_EXEC | _REG_GLOBAL, (void*)(b))
+#define RC_E(a,b) subst_rule(buf, (a), _REG_EXEC | _REG_GLOBAL, (void*)(b))
+
+#define RS_O(a,b) (void)subst_rule(buf, (a), _REG_DEFAULT, (b))
+#define RS_G(a,b) (void)subst_rule(buf, (a), _REG_GLOBAL, (b))
+#define RS_E(a,b) (void)RC_E(a,b)
 
 static char *guess_encoding(void);
-static void write_to_file(STRBUF *outbuf, const char *filename);
+static int open_output(const char *filename);
+static void open_outputs(void);
+static void write_fd(int fd, const char *name, const char *data, size_t len);
+static void write_output(struct target *t, const char *data, size_t len);
+
+/*
+ * With --profile, the memory traffic and regex work of every rule of
+ * format_doc and subst_doc is summed up and printed when odt2txt is
+ * done.  A rule is a regex substitution, named by its pattern, or one
+ * of the passes "tags" and "substs".
+ */
+struct rule_cost {
+	const char *name;
+	size_t calls;
+	struct strbuf_stats sb;
+	struct regex_stats rx;
+};
+
+struct rule_mark {
+	struct strbuf_stats sb;
+	struct regex_stats rx;
+};
+
+#define MAX_RULES 32
+
+static struct rule_cost rule_costs[MAX_RULES];
+static size_t num_rules;
+#ifndef NO_THREADS
+static pthread_mutex_t rule_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void rule_start(struct rule_mark *m)
+{
+	if (!opt_profile)
+		return;
+	strbuf_stats(&m->sb);
+	regex_stats(&m->rx);
+}
+
+static void rule_done(const char *name, const struct rule_mark *m)
+{
+	struct strbuf_stats sb;
+	struct regex_stats rx;
+	struct rule_cost *r;
+	size_t i;
+
+	if (!opt_profile)
+		return;
+	strbuf_stats(&sb);
+	regex_stats(&rx);
+
+	/* slides are formatted on several threads */
+#ifndef NO_THREADS
+	pthread_mutex_lock(&rule_lock);
+#endif
+	for (i = 0; i < num_rules; i++)
+		if (!strcmp(rule_costs[i].name, name))
+			break;
+	if (i == num_rules && i < MAX_RULES) {
+		rule_costs[i].name = name;
+		num_rules++;
+	}
+
+	if (i < num_rules) {
+		r = &rule_costs[i];
+		r->calls++;
+		r->sb.moved += sb.moved - m->sb.moved;
+		r->sb.copied += sb.copied - m->sb.copied;
+		r->sb.reallocs += sb.reallocs - m->sb.reallocs;
+		r->sb.realloc_copied +=
+			sb.realloc_copied - m->sb.realloc_copied;
+		r->rx.passes += rx.passes - m->rx.passes;
+		r->rx.matches += rx.matches - m->rx.matches;
+		r->rx.scanned += rx.scanned - m->rx.scanned;
+	}
+#ifndef NO_THREADS
+	pthread_mutex_unlock(&rule_lock);
+#endif
+}
+
+static int subst_rule(STRBUF *buf, const char *regex, int regopt,
+		      const void *subst)
+{
+	struct rule_mark m;
+	int n;
+
+	rule_start(&m);
+	n = regex_subst(buf, regex, regopt, subst);
+	rule_done(regex, &m);
+	return n;
+}
+
+/* prints a rule name with its control characters escaped */
+static void print_rule_name(const char *name)
+{
+	for (; *name; name++) {
+		if (*name == '\n')
+			fputs("\\n", stderr);
+		else if ((unsigned char)*name < 0x20)
+			fprintf(stderr, "\\%03o", (unsigned char)*name);
+		else
+			putc(*name, stderr);
+	}
+	putc('\n', stderr);
+}
+
+static void print_rule_costs(void)
+{
+	const struct rule_cost *r;
+	size_t i;
+
+	fprintf(stderr, "%6s %12s %12s %8s %12s %6s %8s %12s  %s\n",
+		"calls", "moved", "copied", "reallocs", "realloc'd",
+		"passes", "matches", "scanned", "rule");
+	for (i = 0; i < num_rules; i++) {
+		r = &rule_costs[i];
+		fprintf(stderr, "%6lu %12lu %12lu %8lu %12lu %6lu %8lu %12lu  ",
+			(unsigned long)r->calls,
+			(unsigned long)r->sb.moved,
+			(unsigned long)r->sb.copied,
+			(unsigned long)r->sb.reallocs,
+			(unsigned long)r->sb.realloc_copied,
+			(unsigned long)r->rx.passes,
+			(unsigned long)r->rx.matches,
+			(unsigned long)r->rx.scanned);
+		print_rule_name(r->name);
+	}
+}
 
 struct subst {
 	int unicode;
@@ -132,11 +313,32 @@ static struct subst substs[] = {
 	{ 0,      NULL,           NULL },
 };
 
+/* the entities which format_text decodes, in its order */
+static const char *const entities[][2] = {
+	{ "&apos;", "'"  },
+	{ "&amp;",  "&"  },
+	{ "&quot;", "\"" },
+	{ "&gt;",   ">"  },
+	{ "&lt;",   "<"  },
+};
+
+#define NUM_ENTITIES (sizeof(entities) / sizeof(entities[0]))
+
+/* the entries of substs which a target replaces */
+struct subst_set {
+	const struct subst *use[sizeof(substs) / sizeof(substs[0])];
+	size_t len[sizeof(substs) / sizeof(substs[0])];
+	size_t n;
+};
+
+static void subst_choose(struct target *t, struct subst_set *set);
+
 static void usage(void)
 {
 	printf("odt2txt %s\n"
 	       "Converts an OpenDocument or OpenOffice.org XML File to raw text.\n\n"
-	       "Syntax:   odt2txt [options] filename\n\n"
+	       "Syntax:   odt2txt [options] filename...\n"
+	       "          Directories are searched for OpenDocument files.\n\n"
 	       "Options:  --raw         Print raw XML\n"
 #ifdef NO_ICONV
 	       "          --encoding=X  Ignored. odt2txt has been built without iconv support.\n"
@@ -154,6 +356,41 @@ static void usage(void)
 	       "          --width=X     Wrap text lines after X characters. Default: 65.\n"
 	       "                        If set to -1 then no lines will be broken\n"
 	       "          --output=file Write output to file, instead of STDOUT\n"
+	       "          --cache=dir   Keep formatted documents in dir, so that converting\n"
+	       "                        them again with another width or encoding is cheap\n"
+	       "          --target=X    Add an output target.  X is a comma separated list\n"
+	       "                        of encoding=E, width=W, subst=S and output=file.\n"
+	       "                        Omitted values are taken from the options above.\n"
+	       "                        May be given several times to produce several\n"
+	       "                        outputs from a single parse of the document\n"
+	       "          --chunk-size=N\n"
+	       "                        Split the output into chunks of about N characters\n"
+	       "                        at paragraph boundaries.  Every chunk is preceded\n"
+	       "                        by a line with its number, byte and character\n"
+	       "                        offset, first paragraph and length in bytes\n"
+	       "          --grep=X      Print the paragraphs which match the extended\n"
+	       "                        regular expression X instead of the text\n"
+	       "          --count       With --grep, only print the number of matches\n"
+	       "          --first       With --grep, stop at the first match in a file\n"
+	       "          --stats-only  Print the number of words, characters, paragraphs,\n"
+	       "                        headlines and images instead of the text\n"
+	       "          --index       Also write the byte offsets of the paragraphs and\n"
+	       "                        headlines to a file named like the output with\n"
+	       "                        .idx appended\n"
+	       "          --slides      Convert a presentation slide by slide, with the\n"
+	       "                        speaker notes after each slide\n"
+	       "          --objects     Also convert embedded objects, like charts, where\n"
+	       "                        they are placed in the document\n"
+	       "          --profile     Print the memory traffic and regex work of every\n"
+	       "                        formatting rule to stderr\n"
+	       "          --lookup=file Print a part of the text file, which has been\n"
+	       "                        written with --index, given by one of:\n"
+	       "                           --paragraphs=N[-M]  Paragraphs N to M\n"
+	       "                           --headlines=N[-M]   Headlines N to M with the\n"
+	       "                                               text that follows them\n"
+	       "          --jobs=N      Convert several files with N worker processes,\n"
+	       "                        or the text of a large file on N threads.\n"
+	       "                        Default: number of online processors\n"
 	       "          --subst=X     Select which non-ascii characters shall be replaced\n"
 	       "                        by ascii look-a-likes:\n"
 	       "                           --subst=all   Substitute all characters for which\n"
@@ -174,20 +411,102 @@ static void version_info(void)
 #ifndef HAVE_LIBZIP
 	       "Uses the kunzip library, Copyright 2005,2006 by Michael Kohn\n"
 #endif
+	       "Regex engine: %s\n"
 	       "\n"
 	       "This program is free software; you can redistribute it and/or\n"
 	       "modify it under the terms of the GNU General Public License,\n"
 	       "version 2 as published by the Free Software Foundation\n"
 	       "\n"
 	       "Homepage: http://stosberg.net/odt2txt/\n",
-	       VERSION);
+	       VERSION, rx_engine());
 	exit(EXIT_SUCCESS);
 }
 
-static void yrealloc_buf(char **buf, char **mark, size_t len) {
-	ptrdiff_t offset = *mark - *buf;
-	*buf = yrealloc(*buf, len);
-	*mark = *buf + offset;
+/*
+ * Puts ascii with its entities decoded, as format_text leaves them.
+ * No substitution contains "&amp;", so a single pass gives the same
+ * result as decoding one entity after the other.
+ */
+static void put_decoded(struct strbuf_rewrite *rw, const char *ascii)
+{
+	const char *amp;
+	size_t i, len;
+
+	while ((amp = strchr(ascii, '&'))) {
+		strbuf_rewrite_put(rw, ascii, (size_t)(amp - ascii));
+		for (i = 0; i < NUM_ENTITIES; i++) {
+			len = strlen(entities[i][0]);
+			if (!strncmp(amp, entities[i][0], len))
+				break;
+		}
+		if (i == NUM_ENTITIES) {
+			strbuf_rewrite_put(rw, amp, 1);
+			ascii = amp + 1;
+		} else {
+			strbuf_rewrite_put(rw, entities[i][1], 1);
+			ascii = amp + len;
+		}
+	}
+	strbuf_rewrite_put(rw, ascii, strlen(ascii));
+}
+
+/*
+ * Replaces the characters of set in a single pass over buf.  It uses
+ * no iconv handle, so threads may call it.  If marked is set, buf is
+ * a document from read_marked: its text has been cleaned up by
+ * format_text already, except for the marked headlines.
+ */
+static void subst_apply(const struct subst_set *set, STRBUF *buf, int marked)
+{
+	const char *start, *q, *end;
+	const char *mark_end = NULL;
+	struct strbuf_rewrite rw;
+	struct rule_mark m;
+	size_t i;
+
+	if (!set->n)
+		return;
+
+	rule_start(&m);
+	start = strbuf_get(buf);
+	end = start + strbuf_len(buf);
+
+	/* all entries start with a lead byte of 0xc2 or above */
+	strbuf_rewrite_init(&rw, buf);
+	for (q = start; q < end; q++) {
+		if ((unsigned char)*q < 0xc2) {
+			if (*q == IR_MARK && marked)
+				mark_end = memchr(q, IR_MARK_END,
+						  (size_t)(end - q));
+			continue;
+		}
+		for (i = 0; i < set->n; i++) {
+			if (set->len[i] <= (size_t)(end - q) &&
+			    !memcmp(q, set->use[i]->utf8, set->len[i]))
+				break;
+		}
+		if (i == set->n)
+			continue;
+
+		strbuf_rewrite_keep(&rw, (size_t)(q - start));
+		strbuf_rewrite_skip(&rw, (size_t)(q - start) + set->len[i]);
+		if (marked && !(mark_end && q < mark_end))
+			put_decoded(&rw, set->use[i]->ascii);
+		else
+			strbuf_rewrite_put(&rw, set->use[i]->ascii,
+					   strlen(set->use[i]->ascii));
+		q += set->len[i] - 1;
+	}
+	strbuf_rewrite_finish(&rw);
+	rule_done("substs", &m);
+}
+
+static void subst_doc(struct target *t, STRBUF *buf)
+{
+	struct subst_set set;
+
+	subst_choose(t, &set);
+	subst_apply(&set, buf, 0);
 }
 
 #ifdef NO_ICONV
@@ -202,17 +521,18 @@ static iconv_t init_conv(const char *input_enc, const char *output_enc)
 	return 0;
 }
 
-static STRBUF *conv(iconv_t ic, STRBUF *buf) {
+static STRBUF *conv_n(struct target *t, const char *in, size_t len) {
 	STRBUF *output;
 
 	output = strbuf_new();
-	strbuf_append_n(output, strbuf_get(buf), strbuf_len(buf));
+	strbuf_append_n(output, in, len);
 
 	return output;
 }
 
-static void subst_doc(iconv_t ic, STRBUF *buf) {
-	return;
+static void subst_choose(struct target *t, struct subst_set *set)
+{
+	set->n = 0;
 }
 
 static char *guess_encoding(void)
@@ -220,6 +540,16 @@ static char *guess_encoding(void)
 	return NULL;
 }
 
+static int is_stateless(const char *encoding)
+{
+	return 1;
+}
+
+static int is_utf8(const char *encoding)
+{
+	return 1;
+}
+
 #else
 
 static iconv_t init_conv(const char *input_enc, const char *output_enc)
@@ -229,7 +559,7 @@ static iconv_t init_conv(const char *input_enc, const char *output_enc)
 	if (ic == (iconv_t)-1) {
 		if (errno == EINVAL) {
 			fprintf(stderr, "warning: Conversion from %s to %s is not supported.\n",
-				input_enc, opt_encoding);
+				input_enc, output_enc);
 			ic = iconv_open("us-ascii", input_enc);
 			if (ic == (iconv_t)-1) {
 				exit(EXIT_FAILURE);
@@ -251,39 +581,34 @@ static void finish_conv(iconv_t ic)
 	}
 }
 
-static STRBUF *conv(iconv_t ic, STRBUF *buf)
+static STRBUF *conv_iconv(iconv_t ic, const char *in, size_t len)
 {
-	/* FIXME: This functionality belongs into strbuf.c */
 	ICONV_CHAR *doc;
-	char *out, *outbuf;
-	size_t inleft, outleft = 0;
+	char *out;
+	size_t inleft, outleft;
 	size_t r;
-	size_t outlen = 0;
 	const size_t alloc_step = 4096;
 	STRBUF *output;
 
-	inleft = strbuf_len(buf);
-	doc = (ICONV_CHAR*)strbuf_get(buf);
-	outlen = alloc_step; outleft = alloc_step;
-	outbuf = ymalloc(alloc_step);
-	out = outbuf;
-	outleft = alloc_step;
+	inleft = len;
+	doc = (ICONV_CHAR*)in;
+	output = strbuf_new();
+	strbuf_setopt(output, STRBUF_NULLOK);
 
 	do {
-		if (!outleft) {
-			outlen += alloc_step; outleft += alloc_step;
-			yrealloc_buf(&outbuf, &out, outlen);
-		}
+		size_t room = inleft > alloc_step ? inleft : alloc_step;
+
+		out = strbuf_reserve(output, room);
+		outleft = room;
 		r = iconv(ic, &doc, &inleft, &out, &outleft);
+		strbuf_commit(output, room - outleft);
 		if (r == (size_t)-1) {
 			if(errno == E2BIG) {
-				outlen += alloc_step; outleft += alloc_step;
-				if (outlen > (strbuf_len(buf) << 3)) {
+				if (strbuf_len(output) > (len << 3)) {
 					fprintf(stderr, "Buffer grew to much. "
 						"Corrupted document?\n");
 					exit(EXIT_FAILURE);
 				}
-				yrealloc_buf(&outbuf, &out, outlen);
 				continue;
 			} else if ((errno == EILSEQ) || (errno == EINVAL)) {
 				char skip = 1;
@@ -294,11 +619,7 @@ static STRBUF *conv(iconv_t ic, STRBUF *buf)
 				doc += skip;
 				inleft -= skip;
 
-				/* advance in output buffer */
-				*out = '?';
-				out++;
-				outleft--;
-
+				strbuf_append_n(output, "?", 1);
 				continue;
 			}
 			fprintf(stderr, "iconv returned: %s\n", strerror(errno));
@@ -306,54 +627,281 @@ static STRBUF *conv(iconv_t ic, STRBUF *buf)
 		}
 	} while(inleft != 0);
 
-	if (!outleft) {
-		outbuf = yrealloc(outbuf, outlen + 1);
+	return output;
+}
+
+/*
+ * Copies encoding to norm in lower case and without '-' and '_'.
+ * Returns 0 if it does not fit or names a conversion with options.
+ */
+static int normalize_encoding(char *norm, size_t size, const char *encoding)
+{
+	size_t n = 0;
+
+	for (; *encoding; encoding++) {
+		if (*encoding == '/' || n + 1 == size)
+			return 0;
+		if (*encoding == '-' || *encoding == '_')
+			continue;
+		norm[n++] = (char)tolower((unsigned char)*encoding);
+	}
+	norm[n] = '\0';
+	return 1;
+}
+
+/*
+ * Returns 1 if encoding is known to be converted without state, so
+ * that converting pieces of a text separately gives the same result
+ * as converting it at once.  Encodings with shift states or a byte
+ * order mark, like UTF-7, ISO-2022-* or UTF-16, are not.
+ */
+static int is_stateless(const char *encoding)
+{
+	static const char *prefixes[] = {
+		"utf8", "iso8859", "latin", "usascii", "ascii", "ansix3.4",
+		"cp1250", "cp1251", "cp1252", "cp1253", "cp1254", "cp1256",
+		"cp1257", "windows1250", "windows1251", "windows1252",
+		"windows1253", "windows1254", "windows1256", "windows1257",
+		"koi8", "cp437", "cp850", "cp852", "cp866", "eucjp", "euckr",
+		"gb2312", "gbk", "gb18030", "shiftjis", "sjis", "cp932",
+		NULL
+	};
+	char norm[32];
+	int i;
+
+	if (!normalize_encoding(norm, sizeof(norm), encoding))
+		return 0;
+	for (i = 0; prefixes[i]; i++) {
+		if (!strncmp(norm, prefixes[i], strlen(prefixes[i])))
+			return 1;
 	}
-	*out = '\0';
+	return 0;
+}
+
+/*
+ * Returns 1 if text converted to encoding keeps its bytes.
+ */
+static int is_utf8(const char *encoding)
+{
+	char norm[32];
+
+	return normalize_encoding(norm, sizeof(norm), encoding) &&
+		!strcmp(norm, "utf8");
+}
+
+#ifndef NO_THREADS
+
+/*
+ * Inputs of at least two chunks are converted on several threads.
+ */
+#define CONV_CHUNK (1 << 20)
+
+/*
+ * Returns the first position at or after pos which follows six
+ * ASCII bytes, or end.  Neither a character nor the bytes skipped
+ * after an invalid sequence can cross such a position.
+ */
+static const char *split_point(const char *pos, const char *end)
+{
+	int run = 0;
+
+	for (; pos < end; pos++) {
+		if ((unsigned char)*pos >= 0x80)
+			run = 0;
+		else if (++run == 6)
+			return pos + 1;
+	}
+	return end;
+}
+
+struct conv_chunk {
+	struct target *t;
+	iconv_t ic;
+	const char *in;
+	size_t len;
+	STRBUF *out;
+	pthread_t thread;
+	const struct allocator *alloc;  /* of the calling thread */
+};
+
+static void *conv_chunk(void *data)
+{
+	struct conv_chunk *c = data;
+
+	if (c->t->cs)
+		c->out = charset_conv(c->t->cs, c->in, c->len);
+	else
+		c->out = conv_iconv(c->ic, c->in, c->len);
+	return NULL;
+}
+
+/*
+ * Runs conv_chunk on a thread of its own, with the allocator of the
+ * thread which started it.  Its pool is flushed while the allocator
+ * is still set.
+ */
+static void *conv_chunk_thread(void *data)
+{
+	struct conv_chunk *c = data;
+
+	(void)mem_set_allocator(c->alloc);
+	conv_chunk(c);
+	strbuf_pool_flush();
+	return NULL;
+}
+
+/*
+ * Converts in on up to conv_threads threads, each with its own iconv
+ * handle.  Returns NULL if in has to be converted sequentially.
+ */
+static STRBUF *conv_parallel(struct target *t, const char *in, size_t len)
+{
+	struct conv_chunk *chunks;
+	const char *end = in + len;
+	const char *pos = in;
+	const char *next;
+	STRBUF *output;
+	size_t n, i, num = 0;
+
+	if (!t->cs && !is_stateless(t->encoding))
+		return NULL;
+
+	n = len / CONV_CHUNK;
+	if (n > (size_t)conv_threads)
+		n = (size_t)conv_threads;
+
+	chunks = ymalloc(n * sizeof(struct conv_chunk));
+	for (i = 1; i <= n && pos < end; i++) {
+		next = i < n ? split_point(in + len / n * i, end) : end;
+
+		chunks[num].t = t;
+		chunks[num].ic = t->ic;
+		chunks[num].in = pos;
+		chunks[num].len = (size_t)(next - pos);
+		if (num && !t->cs) {
+			chunks[num].ic = iconv_open(t->encoding, "UTF-8");
+			if (chunks[num].ic == (iconv_t)-1)
+				break;
+		}
+		num++;
+		pos = next;
+	}
+
+	if (pos < end || num < 2) {
+		/* could not open a handle, or no place to split */
+		for (i = 1; i < num; i++) {
+			if (!t->cs)
+				iconv_close(chunks[i].ic);
+		}
+		yfree(chunks);
+		return NULL;
+	}
+
+	for (i = 1; i < num; i++) {
+		chunks[i].alloc = mem_allocator();
+		if (pthread_create(&chunks[i].thread, NULL, conv_chunk_thread,
+				   &chunks[i])) {
+			fprintf(stderr, "Can't create thread\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	conv_chunk(&chunks[0]);
+
+	output = chunks[0].out;
+	for (i = 1; i < num; i++) {
+		pthread_join(chunks[i].thread, NULL);
+		strbuf_append_n(output, strbuf_get(chunks[i].out),
+				strbuf_len(chunks[i].out));
+		strbuf_free(chunks[i].out);
+		if (!t->cs)
+			iconv_close(chunks[i].ic);
+	}
+	yfree(chunks);
 
-	output = strbuf_slurp_n(outbuf, (size_t)(out - outbuf));
-	strbuf_setopt(output, STRBUF_NULLOK);
 	return output;
 }
 
-static void subst_doc(iconv_t ic, STRBUF *buf)
+#endif /* NO_THREADS */
+
+/*
+ * Returns 1 if a text of len bytes is converted on several threads.
+ */
+static int conv_split(size_t len)
+{
+#ifndef NO_THREADS
+	return conv_threads > 1 && len >= 2 * CONV_CHUNK;
+#else
+	return 0;
+#endif
+}
+
+static STRBUF *conv_n(struct target *t, const char *in, size_t len)
+{
+#ifndef NO_THREADS
+	STRBUF *output;
+
+	if (conv_split(len)) {
+		output = conv_parallel(t, in, len);
+		if (output)
+			return output;
+	}
+#endif
+	if (t->cs)
+		return charset_conv(t->cs, in, len);
+	return conv_iconv(t->ic, in, len);
+}
+
+/*
+ * Returns 1 if the output encoding of t can represent the UTF-8
+ * character utf8.
+ */
+static int can_conv(struct target *t, const char *utf8)
 {
-	struct subst *s = substs;
 	ICONV_CHAR *in;
 	size_t inleft;
-	const size_t outbuf_sz = 20;
-	char *outbuf;
+	char outbuf[20];
 	char *out;
 	size_t outleft;
 	size_t r;
 
-	if (opt_subst == SUBST_NONE)
+	if (t->cs)
+		return charset_has(t->cs, utf8);
+
+	out = outbuf;
+	outleft = sizeof(outbuf);
+	in = (ICONV_CHAR*)utf8;
+	inleft = strlen(in);
+	r = iconv(t->ic, &in, &inleft, &out, &outleft);
+	if (r == (size_t)-1) {
+		if ((errno == EILSEQ) || (errno == EINVAL))
+			return 0;
+		fprintf(stderr,
+			"iconv returned an unexpected error: %s\n",
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	return 1;
+}
+
+/*
+ * Chooses the entries of substs which the output encoding lacks, or
+ * all of them with SUBST_ALL.
+ */
+static void subst_choose(struct target *t, struct subst_set *set)
+{
+	struct subst *s;
+
+	set->n = 0;
+	if (t->subst == SUBST_NONE)
 		return;
 
-	outbuf = ymalloc(outbuf_sz);
-	while (s->unicode) {
-		if (opt_subst == SUBST_ALL) {
-			RS_G(s->utf8, s->ascii);
-		} else {
-			out = outbuf;
-			outleft = outbuf_sz;
-			in = (ICONV_CHAR*)s->utf8;
-			inleft = strlen(in);
-			r = iconv(ic, &in, &inleft, &out, &outleft);
-			if (r == (size_t)-1) {
-				if ((errno == EILSEQ) || (errno == EINVAL)) {
-					RS_G(s->utf8, s->ascii);
-				} else {
-					fprintf(stderr,
-						"iconv returned an unexpected error: %s\n",
-						strerror(errno));
-					exit(EXIT_FAILURE);
-				}
-			}
+	for (s = substs; s->unicode; s++) {
+		if (t->subst == SUBST_ALL || !can_conv(t, s->utf8)) {
+			set->use[set->n] = s;
+			set->len[set->n] = strlen(s->utf8);
+			set->n++;
 		}
-		s++;
 	}
-	yfree(outbuf);
 }
 
 static char *guess_encoding(void)
@@ -379,7 +927,56 @@ static char *guess_encoding(void)
 
 #endif
 
-static STRBUF *read_from_zip(const char *zipfile, const char *filename)
+/*
+ * Converts the text in to the encoding of t.  UTF-8 output is the
+ * text itself, so then *out is NULL and in is returned.  Otherwise
+ * *out is the converted text, which the caller must free, and the
+ * result is a view of it.
+ */
+static STRVIEW conv_view(struct target *t, STRVIEW in, STRBUF **out)
+{
+	if (t->same) {
+		*out = NULL;
+		return in;
+	}
+
+	*out = conv_n(t, in.data, in.len);
+	return strbuf_view(*out);
+}
+
+/*
+ * Converts buf to the encoding of t.  buf is used up: it is either
+ * converted in place and returned, or freed.
+ */
+static STRBUF *conv_buf(struct target *t, STRBUF *buf)
+{
+	STRBUF *out = buf;
+
+	TRACE2(conv__start, doc_id, strbuf_len(buf));
+	if (t->same)
+		goto done;
+#ifndef NO_ICONV
+	/* a large text is faster to convert on several threads */
+	if (t->cs && !conv_split(strbuf_len(buf))) {
+		charset_conv_buf(t->cs, buf);
+		goto done;
+	}
+#endif
+
+	out = conv_n(t, strbuf_get(buf), strbuf_len(buf));
+	strbuf_free(buf);
+done:
+	TRACE2(conv__done, doc_id, strbuf_len(out));
+	return out;
+}
+
+/*
+ * Reads filename from zipfile.  If fn is not NULL, it is called
+ * whenever data has been appended to the buffer, see
+ * strbuf_append_inflate_cb.
+ */
+static STRBUF *read_from_zip_cb(const char *zipfile, const char *filename,
+				strbuf_inflate_fn fn, void *data)
 {
 	int r = 0;
 	STRBUF *content = NULL;
@@ -412,17 +1009,34 @@ static STRBUF *read_from_zip(const char *zipfile, const char *filename)
 	}
 
 #ifdef HAVE_LIBZIP
-	if ( !(buf = ymalloc(stat.size + 1)) ||
-	     (zip_fread(unzipped, buf, stat.size) != stat.size) ||
-	     !(content = strbuf_slurp_n(buf, stat.size)) ) {
-		if (buf)
-			yfree(buf);
-		content = NULL;
+	if (fn) {
+		char readbuf[4096];
+		zip_int64_t n;
+
+		content = strbuf_new();
+		while ((n = zip_fread(unzipped, readbuf, sizeof(readbuf))) > 0) {
+			strbuf_append_n(content, readbuf, (size_t)n);
+			if (fn(content, data))
+				break;
+		}
+		if (n < 0) {
+			strbuf_free(content);
+			content = NULL;
+		}
+	} else {
+		content = strbuf_new();
+		buf = strbuf_reserve(content, stat.size);
+		if (zip_fread(unzipped, buf, stat.size) != stat.size) {
+			strbuf_free(content);
+			content = NULL;
+		} else {
+			strbuf_commit(content, stat.size);
+		}
 	}
 	zip_fclose(unzipped);
 	zip_close(zip);
 #else
-	content = kunzip_next_tobuf((char*)zipfile, r);
+	content = kunzip_next_tobuf_cb((char*)zipfile, r, fn, data);
 #endif
 
 	if (!content) {
@@ -435,92 +1049,1969 @@ static STRBUF *read_from_zip(const char *zipfile, const char *filename)
 	return content;
 }
 
-static void format_doc(STRBUF *buf)
+/*
+ * Returns 1 if zipfile has a member filename.  Unlike
+ * read_from_zip_cb, a missing member is not an error.
+ */
+static int zip_has_member(const char *zipfile, const char *filename)
 {
-	/* FIXME: Convert buffer to utf-8 first.  Are there
-	   OpenOffice texts which are not utf8-encoded? */
+#ifdef HAVE_LIBZIP
+	int zip_error;
+	int r;
+	struct zip *zip;
 
-	/* headline, first level */
-	RS_E("<text:h[^>]*outline-level=\"1\"[^>]*>([^<]*)<[^>]*>", &h1);
-	RS_E("<text:h[^>]*>([^<]*)<[^>]*>", &h2);  /* other headlines */
-	RS_G("<text:p [^>]*>", "\n\n");            /* normal paragraphs */
-	RS_G("</text:p>", "\n\n");
-	RS_G("<text:tab/>", "  ");                 /* tabs */
-	RS_G("<text:line-break/>", "\n");
+	if (!(zip = zip_open(zipfile, 0, &zip_error)))
+		return 0;
+	r = zip_name_locate(zip, filename, 0);
+	zip_close(zip);
+	return r >= 0;
+#else
+	return kunzip_get_offset_by_name((char*)zipfile, (char*)filename,
+					 3, -1) != -1;
+#endif
+}
 
-	/* images */
-	RS_E("<draw:frame[^>]*draw:name=\"([^\"]*)\"[^>]*>", &image);
+/*
+ * Replacements for h1 and h2, which leave headlines marked for
+ * ir_encode.  The underline is added later by format_headlines.
+ */
+static char *mark_headline(char line, const char *buf,
+			   regmatch_t matches[], size_t off)
+{
+	size_t len = matches[1].rm_eo - matches[1].rm_so;
+	char *mark = ymalloc(len + 4);
 
-	RS_G("<[^>]*>", ""); 	 /* replace all remaining tags */
-	RS_G("\n +", "\n");      /* remove indentations, e.g. kword */
-	RS_G("\n{3,}", "\n\n");  /* remove large vertical spaces */
+	mark[0] = IR_MARK;
+	mark[1] = line;
+	memcpy(mark + 2, buf + matches[1].rm_so + off, len);
+	mark[len + 2] = IR_MARK_END;
+	mark[len + 3] = '\0';
 
-	RS_G("&apos;", "'");     /* common entities */
-	RS_G("&amp;",  "&");
-	RS_G("&quot;", "\"");
-	RS_G("&gt;",   ">");
-	RS_G("&lt;",   "<");
+	return mark;
+}
 
-	RS_O("^\n+",  "");       /* blank lines at beginning and end of document */
-	RS_O("\n{2,}$",  "\n");
+static char *mark_h1(const char *buf, regmatch_t matches[], size_t nmatch,
+		     size_t off)
+{
+	return mark_headline('=', buf, matches, off);
 }
 
-int main(int argc, const char **argv)
+static char *mark_h2(const char *buf, regmatch_t matches[], size_t nmatch,
+		     size_t off)
 {
-	struct stat st;
-	iconv_t ic;
-	STRBUF *wbuf;
-	STRBUF *docbuf;
-	STRBUF *outbuf;
-	int i = 1;
+	return mark_headline('-', buf, matches, off);
+}
 
-	(void)setlocale(LC_ALL, "");
+struct doc_stats {
+	size_t words;
+	size_t chars;
+	size_t paragraphs;
+	size_t headlines;
+	size_t images;
+};
 
-	while (argv[i]) {
-		if (!strcmp(argv[i], "--raw")) {
-			opt_raw = 1;
-			i++; continue;
-		} else if (!strncmp(argv[i], "--encoding=", 11)) {
-			size_t arglen = strlen(argv[i]) - 10;
-#ifdef iconvlist
-			if (!strcmp(argv[i] + 11, "list")) {
-				show_iconvlist();
-			}
+/*
+ * Finds the name of the image frame whose tag starts at tag->start,
+ * like <draw:frame[^>]*draw:name="([^"]*)"[^>]*> would: the last
+ * draw:name in the tag whose value is closed.  Returns the end of
+ * the match, or NULL if there is no name.
+ */
+static const char *frame_name(const struct odf_tag *tag, const char *end,
+			      const char **name, size_t *len)
+{
+	static const char attr[] = "draw:name=\"";
+	const size_t attr_len = sizeof(attr) - 1;
+	const char *q, *quote, *gt;
+
+	for (q = tag->end - 1 - attr_len; q >= tag->name + 10; q--) {
+		if (memcmp(q, attr, attr_len))
+			continue;
+		quote = memchr(q + attr_len, '"', (size_t)(end - q - attr_len));
+		if (!quote)
+			continue;
+		gt = memchr(quote, '>', (size_t)(end - quote));
+		if (!gt)
+			continue;
+		*name = q + attr_len;
+		*len = (size_t)(quote - *name);
+		return gt + 1;
+	}
+	return NULL;
+}
+
+/*
+ * Replaces the tags left after the headlines in one pass: paragraphs,
+ * tabs, line breaks and image frames become text, all other tags are
+ * dropped.  Returns the number of paragraphs and images in stats.
+ */
+static void format_tags(STRBUF *buf, struct doc_stats *stats)
+{
+	const char *start = strbuf_get(buf);
+	const char *p = start;
+	const char *end = p + strbuf_len(buf);
+	const char *name, *next;
+	size_t len;
+	struct odf_tag tag;
+	struct strbuf_rewrite rw;
+	struct rule_mark m;
+
+	rule_start(&m);
+	/* every replacement is shorter than its tag, so this is done
+	   in place */
+	strbuf_rewrite_init(&rw, buf);
+	while (odf_next_tag(p, end, &tag)) {
+		strbuf_rewrite_keep(&rw, (size_t)(tag.start - start));
+		strbuf_rewrite_skip(&rw, (size_t)(tag.end - start));
+		p = tag.end;
+
+		switch (tag.elem) {
+		case ODF_TEXT_P:
+			if (odf_tag_is(&tag, "</text:p>")) {
+				strbuf_rewrite_put(&rw, "\n\n", 2);
+				stats->paragraphs++;
+			} else if (!tag.closing &&
+				   tag.name[tag.name_len] == ' ') {
+				strbuf_rewrite_put(&rw, "\n\n", 2);
+			}
+			break;
+		case ODF_TEXT_TAB:
+			if (odf_tag_is(&tag, "<text:tab/>"))
+				strbuf_rewrite_put(&rw, "  ", 2);
+			break;
+		case ODF_TEXT_LINE_BREAK:
+			if (odf_tag_is(&tag, "<text:line-break/>"))
+				strbuf_rewrite_put(&rw, "\n", 1);
+			break;
+		case ODF_DRAW_FRAME:
+			if (tag.closing)
+				break;
+			next = frame_name(&tag, end, &name, &len);
+			if (!next)
+				break;
+			strbuf_rewrite_skip(&rw, (size_t)(next - start));
+			strbuf_rewrite_put(&rw, "[-- Image: ", 11);
+			strbuf_rewrite_put(&rw, name, len);
+			strbuf_rewrite_put(&rw, " --]", 4);
+			stats->images++;
+			p = next;
+			break;
+		default:
+			/* everything else is dropped */
+			break;
+		}
+	}
+	strbuf_rewrite_finish(&rw);
+	rule_done("tags", &m);
+}
+
+static void format_markup(STRBUF *buf, int mark, struct doc_stats *stats)
+{
+	struct doc_stats counts = { 0, 0, 0, 0, 0 };
+
+	/* FIXME: Convert buffer to utf-8 first.  Are there
+	   OpenOffice texts which are not utf8-encoded? */
+
+	/* headline, first level */
+	counts.headlines =
+	RC_E("<text:h[^>]*outline-level=\"1\"[^>]*>([^<]*)<[^>]*>",
+	     mark ? &mark_h1 : &h1);
+	counts.headlines +=
+	RC_E("<text:h[^>]*>([^<]*)<[^>]*>",        /* other headlines */
+	     mark ? &mark_h2 : &h2);
+
+	/* paragraphs, tabs, line breaks and images */
+	format_tags(buf, &counts);
+
+	if (stats) {
+		stats->headlines += counts.headlines;
+		stats->paragraphs += counts.paragraphs;
+		stats->images += counts.images;
+	}
+}
+
+/*
+ * Removes indentations, large vertical spaces and blank lines at
+ * the beginning and end of the document.
+ */
+static void format_space(STRBUF *buf)
+{
+	RS_G("\n +", "\n");      /* remove indentations, e.g. kword */
+	RS_G("\n{3,}", "\n\n");  /* remove large vertical spaces */
+
+	RS_O("^\n+",  "");       /* blank lines at beginning and end of document */
+	RS_O("\n{2,}$",  "\n");
+}
+
+/*
+ * Cleans up the text after format_markup.  No entity decodes to
+ * whitespace, so they can be decoded before format_space.
+ */
+static void format_text(STRBUF *buf)
+{
+	RS_G("&apos;", "'");     /* common entities */
+	RS_G("&amp;",  "&");
+	RS_G("&quot;", "\"");
+	RS_G("&gt;",   ">");
+	RS_G("&lt;",   "<");
+
+	format_space(buf);
+}
+
+/*
+ * Reads filename from zipfile.  Invalid UTF-8 is replaced, so that
+ * no later stage has to cope with it.
+ */
+static STRBUF *read_from_zip(const char *zipfile, const char *filename)
+{
+	STRBUF *content;
+
+	TRACE1(read__start, doc_id);
+	content = read_from_zip_cb(zipfile, filename, NULL, NULL);
+	utf8_repair(content);
+	TRACE2(read__done, doc_id, strbuf_len(content));
+	return content;
+}
+
+static void format_doc(STRBUF *buf)
+{
+	TRACE2(format__start, doc_id, strbuf_len(buf));
+	format_markup(buf, 0, NULL);
+	format_text(buf);
+	/* the text is much smaller than the markup it came from */
+	strbuf_shrink(buf);
+	TRACE2(format__done, doc_id, strbuf_len(buf));
+}
+
+/*
+ * Decodes entities like format_text, one after the other, but
+ * leaves the marked headlines alone.
+ */
+static void decode_entities(STRBUF *buf)
+{
+	const char *start, *end, *seg, *stop, *mark, *p;
+	struct strbuf_rewrite rw;
+	size_t i, len;
+
+	for (i = 0; i < NUM_ENTITIES; i++) {
+		len = strlen(entities[i][0]);
+		start = strbuf_get(buf);
+		end = start + strbuf_len(buf);
+
+		strbuf_rewrite_init(&rw, buf);
+		for (seg = start; seg < end; ) {
+			mark = memchr(seg, IR_MARK, (size_t)(end - seg));
+			stop = mark ? mark : end;
+			p = seg;
+			while ((p = memchr(p, '&', (size_t)(stop - p)))) {
+				if ((size_t)(stop - p) < len ||
+				    memcmp(p, entities[i][0], len)) {
+					p++;
+					continue;
+				}
+				strbuf_rewrite_keep(&rw, (size_t)(p - start));
+				strbuf_rewrite_skip(&rw,
+						    (size_t)(p - start) + len);
+				strbuf_rewrite_put(&rw, entities[i][1], 1);
+				p += len;
+			}
+			if (!mark)
+				break;
+			p = memchr(mark, IR_MARK_END, (size_t)(end - mark));
+			seg = p ? p + 1 : end;
+		}
+		strbuf_rewrite_finish(&rw);
+	}
+}
+
+/*
+ * Cleans up a document from format_markup(buf, 1) like format_text.
+ * The text of the headlines keeps its entities, because the length
+ * of their underlines depends on it.  Empty headlines are dropped,
+ * as format_headlines would leave nothing of them.
+ */
+static void format_marked(STRBUF *buf)
+{
+	RS_G("\001[=-]\002", "");
+	decode_entities(buf);
+	format_space(buf);
+}
+
+/*
+ * Reads the document and formats it with marked headlines, or takes
+ * it from the cache if possible.  Substitutions and underlines are
+ * added for each target by finish_doc.
+ */
+static STRBUF *read_marked(const char *filename, const struct stat *st)
+{
+	STRBUF *ir;
+	STRBUF *docbuf = NULL;
+
+	if (opt_cache) {
+		ir = ir_cache_load(opt_cache, filename, st);
+		if (ir) {
+			docbuf = ir_decode(ir);
+			strbuf_free(ir);
+		}
+		if (docbuf)
+			return docbuf;
+	}
+
+	docbuf = read_from_zip(filename, "content.xml");
+	TRACE2(format__start, doc_id, strbuf_len(docbuf));
+	format_markup(docbuf, 1, NULL);
+	format_marked(docbuf);
+	strbuf_shrink(docbuf);
+	TRACE2(format__done, doc_id, strbuf_len(docbuf));
+
+	if (opt_cache) {
+		ir = ir_encode(docbuf);
+		ir_cache_store(opt_cache, filename, st, ir);
+		strbuf_free(ir);
+	}
+
+	return docbuf;
+}
+
+/*
+ * With --index, every headline is followed by INDEX_MARK at the end
+ * of its underline, where it cannot change how the text is wrapped.
+ * render_index takes the marks out again.
+ */
+#define INDEX_MARK '\005'
+
+/*
+ * Underlines the headlines left by format_marked and decodes their
+ * text.  The blank line after the underline replaces the whitespace
+ * that follows, which format_space would remove.
+ */
+static void format_headlines(STRBUF *buf)
+{
+	const char *start = strbuf_get(buf);
+	const char *end = start + strbuf_len(buf);
+	const char *p = start;
+	const char *q;
+	struct strbuf_rewrite rw;
+	static const char mark = INDEX_MARK;
+	STRBUF *text;
+	char *line;
+	size_t len;
+
+	strbuf_rewrite_init(&rw, buf);
+	while ((p = memchr(p, IR_MARK, (size_t)(end - p)))) {
+		if (p + 1 == end || (p[1] != '=' && p[1] != '-') ||
+		    !(q = memchr(p, IR_MARK_END, (size_t)(end - p))) ||
+		    q == p + 2) {
+			p++;
+			continue;
+		}
+		len = (size_t)(q - p - 2);
+		line = underline_view(p[1], strview_n(p + 2, len));
+		text = strbuf_new();
+		strbuf_setopt(text, STRBUF_NULLOK);
+		strbuf_append_n(text, p + 2, len);
+		decode_entities(text);
+
+		strbuf_rewrite_keep(&rw, (size_t)(p - start));
+		strbuf_rewrite_put(&rw, strbuf_get(text), strbuf_len(text));
+		/* the underline, without the blank line */
+		strbuf_rewrite_put(&rw, line + len, strlen(line + len) - 2);
+		if (opt_index)
+			strbuf_rewrite_put(&rw, &mark, 1);
+		for (p = q + 1; p < end && (*p == '\n' || *p == ' '); p++)
+			;
+		strbuf_rewrite_skip(&rw, (size_t)(p - start));
+		strbuf_rewrite_put(&rw, "\n\n", p < end ? 2 : 1);
+
+		strbuf_free(text);
+		yfree(line);
+	}
+	strbuf_rewrite_finish(&rw);
+}
+
+/*
+ * Finishes a document from read_marked for the target t.  This gives
+ * the same text as subst_doc and format_doc on the raw document.
+ */
+static void finish_doc(STRBUF *docbuf, struct target *t)
+{
+	struct subst_set set;
+	size_t i;
+
+	TRACE2(subst__start, doc_id, strbuf_len(docbuf));
+	subst_choose(t, &set);
+	subst_apply(&set, docbuf, 1);
+	TRACE2(subst__done, doc_id, strbuf_len(docbuf));
+	TRACE2(format__start, doc_id, strbuf_len(docbuf));
+	format_headlines(docbuf);
+	/* a no-break space may have become an indentation */
+	for (i = 0; i < set.n; i++) {
+		if (set.use[i]->unicode == 0x00A0) {
+			format_space(docbuf);
+			break;
+		}
+	}
+	TRACE2(format__done, doc_id, strbuf_len(docbuf));
+}
+
+/*
+ * The starts of the paragraphs in the wrapped text and its end, as
+ * reported by wrap_para.
+ */
+struct paras {
+	size_t *offsets;
+	size_t *chars;
+	size_t count;
+	size_t size;
+};
+
+static void add_para(size_t offset, size_t chars, void *data)
+{
+	struct paras *p = data;
+
+	if (p->count == p->size) {
+		p->size = p->size ? p->size << 1 : 64;
+		p->offsets = yrealloc(p->offsets, p->size * sizeof(size_t));
+		p->chars = yrealloc(p->chars, p->size * sizeof(size_t));
+	}
+	p->offsets[p->count] = offset;
+	p->chars[p->count] = chars;
+	p->count++;
+}
+
+static void put_chunk(STRBUF *outbuf, struct target *t, STRBUF *wbuf,
+		      struct paras *p, size_t first, size_t end,
+		      size_t *num, size_t *offset)
+{
+	size_t start = first ? p->offsets[first] : 0;
+	char header[128];
+	STRBUF *chunk;
+
+	TRACE2(conv__start, doc_id, end - start);
+	chunk = conv_n(t, strbuf_get(wbuf) + start, end - start);
+	TRACE2(conv__done, doc_id, strbuf_len(chunk));
+	snprintf(header, sizeof(header), "#chunk\t%lu\t%lu\t%lu\t%lu\t%lu\n",
+		 (unsigned long)*num, (unsigned long)*offset,
+		 (unsigned long)(first ? p->chars[first] : 0),
+		 (unsigned long)first, (unsigned long)strbuf_len(chunk));
+	strbuf_append(outbuf, header);
+	strbuf_append_n(outbuf, strbuf_get(chunk), strbuf_len(chunk));
+
+	(*num)++;
+	*offset += strbuf_len(chunk);
+	strbuf_free(chunk);
+}
+
+/*
+ * Wraps docbuf and converts it in chunks of about opt_chunk_size
+ * characters.  Chunks end at the start of a paragraph, unless a
+ * single paragraph is longer than a chunk.
+ */
+static STRBUF *render_chunks(STRBUF *docbuf, struct target *t)
+{
+	struct paras p = { NULL, NULL, 0, 0 };
+	STRBUF *outbuf = strbuf_new();
+	STRBUF *wbuf;
+	size_t first = 0;   /* first paragraph of the current chunk */
+	size_t num = 0;
+	size_t offset = 0;
+	size_t i;
+
+	strbuf_setopt(outbuf, STRBUF_NULLOK);
+	TRACE2(wrap__start, doc_id, strbuf_len(docbuf));
+	wbuf = wrap_para(docbuf, t->width, add_para, &p);
+	TRACE2(wrap__done, doc_id, strbuf_len(wbuf));
+	strbuf_free(docbuf);
+
+	/* the last entry is the end of the text */
+	for (i = 1; i < p.count; i++) {
+		size_t start = first ? p.chars[first] : 0;
+
+		if (p.chars[i] - start > opt_chunk_size && i - 1 > first) {
+			put_chunk(outbuf, t, wbuf, &p, first,
+				  p.offsets[i - 1], &num, &offset);
+			first = i - 1;
+		}
+	}
+	put_chunk(outbuf, t, wbuf, &p, first, strbuf_len(wbuf),
+		  &num, &offset);
+
+	if (p.size) {
+		yfree(p.offsets);
+		yfree(p.chars);
+	}
+	strbuf_free(wbuf);
+	return outbuf;
+}
+
+/*
+ * Takes the marks of format_headlines out of the wrapped text and moves
+ * the paragraphs in p accordingly.  Returns a flag for every
+ * paragraph whether it is a headline.
+ */
+static char *unmark_index(STRBUF *wbuf, struct paras *p)
+{
+	const char *start = strbuf_get(wbuf);
+	const char *end = start + strbuf_len(wbuf);
+	const char *m = start;
+	char *headline = ymalloc(p->count);
+	size_t removed = 0;
+	size_t i = 0;
+	size_t pos;
+	struct strbuf_rewrite rw;
+
+	memset(headline, 0, p->count);
+	strbuf_rewrite_init(&rw, wbuf);
+	while ((m = memchr(m, INDEX_MARK, (size_t)(end - m)))) {
+		pos = (size_t)(m - start);
+		for (; i < p->count && p->offsets[i] <= pos; i++) {
+			p->offsets[i] -= removed;
+			p->chars[i] -= removed;
+		}
+		if (i)
+			headline[i - 1] = 1;
+		strbuf_rewrite_keep(&rw, pos);
+		strbuf_rewrite_skip(&rw, pos + 1);
+		removed++;
+		m++;
+	}
+	for (; i < p->count; i++) {
+		p->offsets[i] -= removed;
+		p->chars[i] -= removed;
+	}
+	strbuf_rewrite_finish(&rw);
+
+	return headline;
+}
+
+/*
+ * Wraps and converts docbuf like render, and keeps the offsets of
+ * its paragraphs in the output in t->index.  UTF-8 output has the
+ * offsets of the wrapped text.  Other encodings are converted
+ * paragraph by paragraph to learn them, which gives the same text
+ * because they are converted without state.
+ */
+static STRBUF *render_index(STRBUF *docbuf, struct target *t)
+{
+	struct paras p = { NULL, NULL, 0, 0 };
+	struct paraidx idx;
+	STRBUF *outbuf, *wbuf, *piece;
+	const char *text;
+	char *headline;
+	size_t prev = 0;
+	size_t offset, i;
+
+	TRACE2(wrap__start, doc_id, strbuf_len(docbuf));
+	wbuf = wrap_para(docbuf, t->width, add_para, &p);
+	TRACE2(wrap__done, doc_id, strbuf_len(wbuf));
+	strbuf_free(docbuf);
+	headline = unmark_index(wbuf, &p);
+	text = strbuf_get(wbuf);
+	if (t->same) {
+		outbuf = wbuf;
+	} else {
+		outbuf = strbuf_new();
+		strbuf_setopt(outbuf, STRBUF_NULLOK);
+	}
+
+	/* the last entry is the end of the text */
+	TRACE2(conv__start, doc_id, strbuf_len(wbuf));
+	paraidx_init(&idx);
+	for (i = 0; i < p.count; i++) {
+		if (!t->same && p.offsets[i] > prev) {
+			piece = conv_n(t, text + prev, p.offsets[i] - prev);
+			strbuf_append_n(outbuf, strbuf_get(piece),
+					strbuf_len(piece));
+			strbuf_free(piece);
+			prev = p.offsets[i];
+		}
+		offset = t->same ? p.offsets[i] : strbuf_len(outbuf);
+		if (i + 1 < p.count)
+			paraidx_add(&idx, offset, headline[i]);
+		else
+			paraidx_end(&idx, offset);
+	}
+	TRACE2(conv__done, doc_id, strbuf_len(outbuf));
+	t->index = paraidx_encode(&idx);
+
+	paraidx_free(&idx);
+	if (p.size) {
+		yfree(p.offsets);
+		yfree(p.chars);
+		yfree(headline);
+	}
+	if (wbuf != outbuf)
+		strbuf_free(wbuf);
+	return outbuf;
+}
+
+/*
+ * Wraps and converts docbuf for t and returns the result.  docbuf is
+ * used up: every stage works in place or frees its input as soon as
+ * its output is complete.
+ */
+static STRBUF *render(STRBUF *docbuf, struct target *t)
+{
+	STRBUF *wbuf;
+
+	if (opt_chunk_size)
+		return render_chunks(docbuf, t);
+	if (opt_index)
+		return render_index(docbuf, t);
+
+	TRACE2(wrap__start, doc_id, strbuf_len(docbuf));
+	(void)wrap_view(docbuf, t->width, &wbuf);
+	TRACE2(wrap__done, doc_id, strbuf_len(wbuf ? wbuf : docbuf));
+	if (wbuf) {
+		strbuf_free(docbuf);
+		docbuf = wbuf;
+	}
+	return conv_buf(t, docbuf);
+}
+
+/*
+ * Returns a copy of docbuf for a target which is not the last one,
+ * or docbuf itself for the last.
+ */
+static STRBUF *target_doc(STRBUF *docbuf, size_t i)
+{
+	STRBUF *tbuf;
+
+	if (i + 1 == num_targets)
+		return docbuf;
+
+	tbuf = strbuf_new();
+	strbuf_setopt(tbuf, STRBUF_NULLOK);
+	strbuf_append_n(tbuf, strbuf_get(docbuf), strbuf_len(docbuf));
+	return tbuf;
+}
+
+/*
+ * With --slides, the draw:page elements of a presentation are cut
+ * out of content.xml while it is inflated.  Once the pages collected
+ * hold SLIDES_BATCH bytes of XML per thread, they are split into runs
+ * of consecutive slides, one for each of conv_threads threads.  The
+ * texts are appended in order.  So at most one batch of XML is kept,
+ * plus the page being inflated.  Text outside the pages is dropped.
+ */
+#define SLIDES_BATCH (256 * 1024)
+
+struct slide {
+	STRBUF *buf;                  /* the page, then its text */
+	size_t number;
+	const struct subst_set *set;
+};
+
+struct slide_run {
+	struct slide *first;
+	size_t num;
+#ifndef NO_THREADS
+	pthread_t thread;
+	const struct allocator *alloc;  /* of the calling thread */
+#endif
+};
+
+struct slides {
+	STRBUF *out;         /* the text of the slides so far */
+	struct slide *batch;
+	size_t num;          /* slides in the batch */
+	size_t size;         /* room in the batch */
+	size_t bytes;        /* of XML in the batch */
+	size_t count;        /* slides so far */
+	size_t scanned;      /* no complete tag starts before this */
+	size_t start;        /* of the open page */
+	int open;
+	struct subst_set set;
+};
+
+/*
+ * Formats the text of a page, followed by its speaker notes.  Like
+ * subst_doc, the substitutions are made before format_doc.
+ */
+static void format_slide(struct slide *sl)
+{
+	const char *start = strbuf_get(sl->buf);
+	const char *end = start + strbuf_len(sl->buf);
+	const char *p = start;
+	const char *name = NULL;
+	size_t name_len = 0;
+	size_t notes_start = 0;
+	struct odf_tag tag;
+	STRBUF *text, *notes = NULL;
+	char num[32];
+
+	while (odf_next_tag(p, end, &tag)) {
+		p = tag.end;
+		if (tag.elem == ODF_DRAW_PAGE && !tag.closing && !name)
+			(void)frame_name(&tag, end, &name, &name_len);
+		if (tag.elem != ODF_PRESENTATION_NOTES || tag.empty)
+			continue;
+		if (!tag.closing) {
+			notes_start = (size_t)(tag.start - start);
+		} else if (notes_start && !notes) {
+			notes = strbuf_new();
+			strbuf_append_n(notes, start + notes_start,
+					(size_t)(tag.end - start) - notes_start);
+		}
+	}
+
+	text = strbuf_new();
+	snprintf(num, sizeof(num), "[-- Slide %lu", (unsigned long)sl->number);
+	strbuf_append(text, num);
+	if (name) {
+		strbuf_append_n(text, ": ", 2);
+		strbuf_append_n(text, name, name_len);
+	}
+	strbuf_append(text, " --]\n\n");
+
+	/* the notes have been copied out */
+	if (notes)
+		strbuf_subst(sl->buf, notes_start,
+			     notes_start + strbuf_len(notes), "");
+	subst_apply(sl->set, sl->buf, 0);
+	format_doc(sl->buf);
+	if (strbuf_len(sl->buf)) {
+		strbuf_append_n(text, strbuf_get(sl->buf), strbuf_len(sl->buf));
+		strbuf_append_n(text, "\n", 1);
+	}
+
+	if (notes) {
+		subst_apply(sl->set, notes, 0);
+		format_doc(notes);
+		if (strbuf_len(notes)) {
+			strbuf_append(text, "[-- Notes --]\n\n");
+			strbuf_append_n(text, strbuf_get(notes),
+					strbuf_len(notes));
+			strbuf_append_n(text, "\n", 1);
+		}
+		strbuf_free(notes);
+	}
+
+	strbuf_free(sl->buf);
+	sl->buf = text;
+}
+
+static void format_run(struct slide_run *run)
+{
+	size_t i;
+
+	for (i = 0; i < run->num; i++)
+		format_slide(&run->first[i]);
+}
+
+#ifndef NO_THREADS
+static void *format_run_thread(void *data)
+{
+	struct slide_run *run = data;
+
+	(void)mem_set_allocator(run->alloc);
+	format_run(run);
+	strbuf_pool_flush();
+	return NULL;
+}
+#endif
+
+/*
+ * Formats the slides of the batch and appends them to the text.
+ */
+static void run_slides(struct slides *s)
+{
+	struct slide_run *runs;
+	size_t nruns = (size_t)conv_threads;
+	size_t i, n, bytes;
+
+	if (nruns > s->num)
+		nruns = s->num;
+	if (!nruns)
+		return;
+	runs = ymalloc(nruns * sizeof(struct slide_run));
+
+	/* runs of about the same number of bytes */
+	for (i = 0, n = 0; i < nruns; i++) {
+		runs[i].first = &s->batch[n];
+		runs[i].num = 0;
+		bytes = 0;
+		while (n < s->num && (i + 1 == nruns ||
+				      bytes < s->bytes / nruns)) {
+			bytes += strbuf_len(s->batch[n++].buf);
+			runs[i].num++;
+		}
+	}
+
+#ifndef NO_THREADS
+	for (i = 1; i < nruns; i++) {
+		runs[i].alloc = mem_allocator();
+		if (pthread_create(&runs[i].thread, NULL, format_run_thread,
+				   &runs[i])) {
+			fprintf(stderr, "Can't create thread\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	format_run(&runs[0]);
+	for (i = 1; i < nruns; i++)
+		pthread_join(runs[i].thread, NULL);
+#else
+	for (i = 0; i < nruns; i++)
+		format_run(&runs[i]);
+#endif
+	yfree(runs);
+
+	for (i = 0; i < s->num; i++) {
+		strbuf_append_n(s->out, strbuf_get(s->batch[i].buf),
+				strbuf_len(s->batch[i].buf));
+		strbuf_free(s->batch[i].buf);
+	}
+	s->num = 0;
+	s->bytes = 0;
+}
+
+static void add_slide(struct slides *s, const char *page, size_t len)
+{
+	struct slide *sl;
+
+	if (s->num == s->size) {
+		s->size = s->size ? s->size * 2 : 64;
+		s->batch = yrealloc(s->batch, s->size * sizeof(struct slide));
+	}
+	sl = &s->batch[s->num++];
+	sl->buf = strbuf_new();
+	strbuf_append_n(sl->buf, page, len);
+	utf8_repair(sl->buf);
+	sl->number = ++s->count;
+	sl->set = &s->set;
+
+	s->bytes += len;
+	if (s->bytes >= (size_t)conv_threads * SLIDES_BATCH)
+		run_slides(s);
+}
+
+/*
+ * Cuts the complete pages inflated so far out of the buffer and drops
+ * everything before the page which is still open.
+ */
+static int slides_inflated(STRBUF *buf, void *data)
+{
+	struct slides *s = data;
+	const char *start = strbuf_get(buf);
+	const char *end = start + strbuf_len(buf);
+	const char *p = start + s->scanned;
+	struct odf_tag tag;
+	size_t cut;
+
+	while (odf_next_tag(p, end, &tag)) {
+		p = tag.end;
+		if (tag.elem != ODF_DRAW_PAGE)
+			continue;
+		if (!tag.closing) {
+			s->start = (size_t)(tag.start - start);
+			s->open = 1;
+		}
+		if (s->open && (tag.closing || tag.empty)) {
+			add_slide(s, start + s->start,
+				  (size_t)(tag.end - start) - s->start);
+			s->open = 0;
+		}
+	}
+
+	/* a tag after p might be incomplete */
+	cut = s->open ? s->start : (size_t)(p - start);
+	if (cut)
+		strbuf_subst(buf, 0, cut, "");
+	s->scanned = (size_t)(p - start) - cut;
+	if (s->open)
+		s->start -= cut;
+
+	return 0;
+}
+
+/*
+ * Returns the text of the slides of filename, ready to be rendered.
+ */
+static STRBUF *read_slides(const char *filename, struct target *t)
+{
+	struct slides s;
+	STRBUF *rest;
+
+	s.out = strbuf_new();
+	s.batch = NULL;
+	s.size = 0;
+	s.num = 0;
+	s.bytes = 0;
+	s.count = 0;
+	s.scanned = 0;
+	s.start = 0;
+	s.open = 0;
+	subst_choose(t, &s.set);
+
+	/* format_doc fires the format probes of every slide */
+	TRACE1(read__start, doc_id);
+	rest = read_from_zip_cb(filename, "content.xml", slides_inflated, &s);
+	(void)slides_inflated(rest, &s);
+	strbuf_free(rest);
+	run_slides(&s);
+	if (s.batch)
+		yfree(s.batch);
+	if (!s.count) {
+		fprintf(stderr, "%s: No slides found.  Is it a presentation?\n",
+			filename);
+		exit(EXIT_FAILURE);
+	}
+	TRACE2(read__done, doc_id, strbuf_len(s.out));
+
+	return s.out;
+}
+
+/*
+ * With --objects, the embedded objects of a document, like charts,
+ * are converted too.  Every draw:object tag which refers to a member
+ * of the archive is replaced by \003N\004, where N is the number of
+ * the object.  The objects are read and formatted on up to
+ * conv_threads - 1 threads while the body is formatted, and their
+ * texts are spliced in as paragraphs of their own.  Objects within
+ * objects are left out.
+ */
+#define OBJECT_MARK     '\003'
+#define OBJECT_MARK_END '\004'
+
+struct object {
+	char *member;   /* e.g. "Object 1/content.xml" */
+	STRBUF *buf;    /* its text, or NULL if there is none */
+};
+
+struct objects {
+	const char *zipfile;
+	struct object *list;
+	size_t num;
+	size_t size;
+	struct subst_set set;
+};
+
+struct object_run {
+	struct objects *o;
+	size_t first;    /* this run formats first, first + step, ... */
+	size_t step;
+#ifndef NO_THREADS
+	pthread_t thread;
+	const struct allocator *alloc;  /* of the calling thread */
+#endif
+};
+
+/*
+ * Returns the member holding the content of the object whose tag
+ * is given, or NULL if it does not refer to the archive.
+ */
+static char *object_member(const struct odf_tag *tag)
+{
+	static const char attr[] = "xlink:href=\"";
+	static const char content[] = "/content.xml";
+	const size_t attr_len = sizeof(attr) - 1;
+	const char *p, *href, *quote;
+	size_t len;
+	char *member;
+
+	for (p = tag->name + tag->name_len;
+	     p + attr_len <= tag->end; p++) {
+		if (!memcmp(p, attr, attr_len))
+			break;
+	}
+	if (p + attr_len > tag->end)
+		return NULL;
+	href = p + attr_len;
+	quote = memchr(href, '"', (size_t)(tag->end - href));
+	if (!quote)
+		return NULL;
+
+	len = (size_t)(quote - href);
+	if (len >= 2 && !memcmp(href, "./", 2)) {
+		href += 2;
+		len -= 2;
+	}
+	while (len && href[len - 1] == '/')
+		len--;
+	if (!len || href[0] == '/' || (len >= 2 && !memcmp(href, "..", 2)) ||
+	    memchr(href, ':', len))
+		return NULL;
+
+	member = ymalloc(len + sizeof(content));
+	memcpy(member, href, len);
+	memcpy(member + len, content, sizeof(content));
+	return member;
+}
+
+/*
+ * Replaces the draw:object tags of buf by marks and collects the
+ * objects they refer to.
+ */
+static void mark_objects(STRBUF *buf, struct objects *o)
+{
+	const char *start = strbuf_get(buf);
+	const char *p = start;
+	const char *end = p + strbuf_len(buf);
+	struct odf_tag tag;
+	struct strbuf_rewrite rw;
+	char *member;
+	char mark[32];
+
+	strbuf_rewrite_init(&rw, buf);
+	while (odf_next_tag(p, end, &tag)) {
+		p = tag.end;
+		if (tag.elem != ODF_DRAW_OBJECT || tag.closing)
+			continue;
+		member = object_member(&tag);
+		if (!member)
+			continue;
+
+		if (o->num == o->size) {
+			o->size = o->size ? o->size * 2 : 16;
+			o->list = yrealloc(o->list,
+					   o->size * sizeof(struct object));
+		}
+		o->list[o->num].member = member;
+		o->list[o->num].buf = NULL;
+		snprintf(mark, sizeof(mark), "%c%lu%c", OBJECT_MARK,
+			 (unsigned long)o->num, OBJECT_MARK_END);
+		o->num++;
+
+		strbuf_rewrite_keep(&rw, (size_t)(tag.start - start));
+		strbuf_rewrite_skip(&rw, (size_t)(tag.end - start));
+		strbuf_rewrite_put(&rw, mark, strlen(mark));
+	}
+	strbuf_rewrite_finish(&rw);
+}
+
+/*
+ * Reads and formats the objects of a run.  Objects without a
+ * content.xml, like pictures which replace OLE objects, are skipped.
+ */
+static void format_objects(struct object_run *run)
+{
+	struct objects *o = run->o;
+	struct object *obj;
+	size_t i;
+
+	for (i = run->first; i < o->num; i += run->step) {
+		obj = &o->list[i];
+		if (!zip_has_member(o->zipfile, obj->member))
+			continue;
+		obj->buf = read_from_zip(o->zipfile, obj->member);
+		subst_apply(&o->set, obj->buf, 0);
+		format_doc(obj->buf);
+	}
+}
+
+#ifndef NO_THREADS
+static void *format_objects_thread(void *data)
+{
+	struct object_run *run = data;
+
+	(void)mem_set_allocator(run->alloc);
+	format_objects(run);
+	strbuf_pool_flush();
+	return NULL;
+}
+#endif
+
+/*
+ * Ends the text so far with a blank line, unless it is empty.
+ */
+static void objects_break(STRBUF *out)
+{
+	size_t len = strbuf_len(out);
+
+	while (len && strbuf_get(out)[len - 1] == '\n')
+		len--;
+	strbuf_truncate(out, len);
+	if (len)
+		strbuf_append_n(out, "\n\n", 2);
+}
+
+/*
+ * Returns the text with the marks replaced by the texts of their
+ * objects, each separated from the text around it by a blank line.
+ */
+static STRBUF *splice_objects(STRBUF *docbuf, struct objects *o)
+{
+	const char *p = strbuf_get(docbuf);
+	const char *end = p + strbuf_len(docbuf);
+	const char *mark, *q;
+	unsigned long n;
+	int blank = 0;  /* a blank line is due before more text */
+	STRBUF *out = strbuf_new();
+	STRBUF *text;
+
+	while (p < end) {
+		mark = memchr(p, OBJECT_MARK, (size_t)(end - p));
+		if (!mark)
+			mark = end;
+		text = NULL;
+		q = mark;
+		if (mark < end) {
+			n = 0;
+			for (q = mark + 1; q < end && *q >= '0' && *q <= '9'; q++)
+				n = n * 10 + (unsigned long)(*q - '0');
+			if (q == mark + 1 || q == end || *q != OBJECT_MARK_END ||
+			    n >= o->num) {
+				/* not one of ours, keep it as text */
+				mark = q;
+			} else {
+				text = o->list[n].buf;
+				q++;
+			}
+		}
+
+		if (blank) {
+			while (p < mark && *p == '\n')
+				p++;
+			if (p < mark) {
+				objects_break(out);
+				blank = 0;
+			}
+		}
+		strbuf_append_n(out, p, (size_t)(mark - p));
+		p = q;
+
+		/* objects without text just disappear */
+		if (text && strbuf_len(text)) {
+			objects_break(out);
+			strbuf_append_n(out, strbuf_get(text),
+					strbuf_len(text));
+			blank = 1;
+		}
+	}
+	/* and a single newline at the end, like format_text leaves */
+	objects_break(out);
+	if (strbuf_len(out))
+		strbuf_truncate(out, strbuf_len(out) - 1);
+
+	strbuf_free(docbuf);
+	return out;
+}
+
+/*
+ * Formats docbuf, the content.xml of filename, with the texts of
+ * its objects spliced in.
+ */
+static STRBUF *format_with_objects(const char *filename, STRBUF *docbuf,
+				   struct target *t)
+{
+	struct objects o;
+	struct object_run *runs;
+	size_t nruns = (size_t)conv_threads - 1;
+	size_t i;
+
+	o.zipfile = filename;
+	o.list = NULL;
+	o.num = 0;
+	o.size = 0;
+	subst_choose(t, &o.set);
+	mark_objects(docbuf, &o);
+
+	/* the body is formatted on this thread */
+	if (nruns > o.num)
+		nruns = o.num;
+	runs = ymalloc((nruns ? nruns : 1) * sizeof(struct object_run));
+	for (i = 0; i < nruns; i++) {
+		runs[i].o = &o;
+		runs[i].first = i;
+		runs[i].step = nruns;
+	}
+
+#ifndef NO_THREADS
+	for (i = 0; i < nruns; i++) {
+		runs[i].alloc = mem_allocator();
+		if (pthread_create(&runs[i].thread, NULL,
+				   format_objects_thread, &runs[i])) {
+			fprintf(stderr, "Can't create thread\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+#endif
+
+	TRACE2(subst__start, doc_id, strbuf_len(docbuf));
+	subst_apply(&o.set, docbuf, 0);
+	TRACE2(subst__done, doc_id, strbuf_len(docbuf));
+	format_doc(docbuf);
+
+#ifndef NO_THREADS
+	for (i = 0; i < nruns; i++)
+		pthread_join(runs[i].thread, NULL);
+#else
+	nruns = 0;
+#endif
+	if (!nruns && o.num) {
+		runs[0].o = &o;
+		runs[0].first = 0;
+		runs[0].step = 1;
+		format_objects(&runs[0]);
+	}
+	yfree(runs);
+
+	if (o.num)
+		docbuf = splice_objects(docbuf, &o);
+	for (i = 0; i < o.num; i++) {
+		yfree(o.list[i].member);
+		if (o.list[i].buf)
+			strbuf_free(o.list[i].buf);
+	}
+	if (o.list)
+		yfree(o.list);
+
+	return docbuf;
+}
+
+/*
+ * Converts filename for every target.  out must have room for
+ * num_targets results.
+ */
+static void convert(const char *filename, STRBUF **out)
+{
+	struct stat st;
+	STRBUF *docbuf;
+	STRBUF *tbuf;
+	size_t i;
+
+	if (0 != stat(filename, &st)) {
+		fprintf(stderr, "%s: %s\n",
+			filename, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	doc_id++;
+	TRACE3(doc__start, doc_id, filename, st.st_size);
+
+	if (opt_slides) {
+		docbuf = read_slides(filename, &targets[0]);
+		out[0] = render(docbuf, &targets[0]);
+	} else if (opt_raw || (num_targets == 1 && !opt_cache && !opt_index)) {
+		/* read content.xml */
+		docbuf = read_from_zip(filename, "content.xml");
+
+		if (opt_objects) {
+			docbuf = format_with_objects(filename, docbuf,
+						     &targets[0]);
+		} else if (!opt_raw) {
+			TRACE2(subst__start, doc_id, strbuf_len(docbuf));
+			subst_doc(&targets[0], docbuf);
+			TRACE2(subst__done, doc_id, strbuf_len(docbuf));
+			format_doc(docbuf);
+		}
+
+		for (i = 0; i < num_targets; i++)
+			out[i] = render(target_doc(docbuf, i), &targets[i]);
+	} else {
+		/* also for --index, which finds the headlines by their
+		   marks */
+		docbuf = read_marked(filename, &st);
+		for (i = 0; i < num_targets; i++) {
+			tbuf = target_doc(docbuf, i);
+			finish_doc(tbuf, &targets[i]);
+			out[i] = render(tbuf, &targets[i]);
+		}
+	}
+
+	TRACE3(doc__done, doc_id, filename, strbuf_len(out[0]));
+}
+
+/*
+ * State of the search in a single document.  The document is
+ * formatted and searched paragraph by paragraph while it is
+ * inflated, and inflating stops as soon as the result is known.
+ */
+struct grep {
+	const char *filename;
+	STRBUF *out;      /* matching lines or the count */
+	size_t scanned;   /* no paragraph ends before this position */
+	size_t count;
+	int done;
+	struct subst_set set;   /* of the first target */
+};
+
+static int grep_line(const char *line, size_t len, void *data)
+{
+	struct grep *g = data;
+	STRBUF *conv_line;
+	STRVIEW text;
+
+	g->count++;
+	if (opt_first)
+		g->done = 1;
+	if (opt_count)
+		return g->done;
+
+	if (opt_num_filenames > 1) {
+		strbuf_append(g->out, g->filename);
+		strbuf_append_n(g->out, ":", 1);
+	}
+	text = conv_view(&targets[0], strview_n(line, len), &conv_line);
+	strbuf_append_view(g->out, text);
+	strbuf_append_n(g->out, "\n", 1);
+	if (conv_line)
+		strbuf_free(conv_line);
+
+	return g->done;
+}
+
+static void grep_text(struct grep *g, const char *text, size_t len)
+{
+	STRBUF *buf = strbuf_new();
+
+	strbuf_append_n(buf, text, len);
+	utf8_repair(buf);
+	/* like convert, so that the lines match its output */
+	subst_apply(&g->set, buf, 0);
+	format_doc(buf);
+	(void)regex_grep(grep_rx, strbuf_get(buf), strbuf_len(buf),
+			 grep_line, g);
+	strbuf_free(buf);
+}
+
+/*
+ * Returns the position after the last end of a paragraph or
+ * headline in buf[from..len), or 0 if there is none.
+ */
+static size_t last_para_end(const char *buf, size_t from, size_t len)
+{
+	const char *p = buf + from;
+	const char *end = buf + len;
+	size_t cut = 0;
+
+	while ((p = memchr(p, '<', (size_t)(end - p)))) {
+		if (end - p >= 9 && (!memcmp(p, "</text:p>", 9) ||
+				     !memcmp(p, "</text:h>", 9)))
+			cut = (size_t)(p + 9 - buf);
+		p++;
+	}
+	return cut;
+}
+
+/*
+ * Searches all complete paragraphs inflated so far and drops them
+ * from the buffer.
+ */
+static int grep_inflated(STRBUF *buf, void *data)
+{
+	struct grep *g = data;
+	size_t cut;
+
+	cut = last_para_end(strbuf_get(buf), g->scanned, strbuf_len(buf));
+	if (cut) {
+		grep_text(g, strbuf_get(buf), cut);
+		strbuf_subst(buf, 0, cut, "");
+	}
+
+	/* a closing tag might be incomplete */
+	g->scanned = strbuf_len(buf) > 8 ? strbuf_len(buf) - 8 : 0;
+
+	return g->done;
+}
+
+static STRBUF *grep_file(const char *filename, size_t *count)
+{
+	struct stat st;
+	struct grep g;
+	STRBUF *rest;
+	char num[32];
+
+	if (0 != stat(filename, &st)) {
+		fprintf(stderr, "%s: %s\n",
+			filename, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	doc_id++;
+	TRACE3(doc__start, doc_id, filename, st.st_size);
+
+	g.filename = filename;
+	g.out = strbuf_new();
+	g.scanned = 0;
+	g.count = 0;
+	g.done = 0;
+	subst_choose(&targets[0], &g.set);
+
+	rest = read_from_zip_cb(filename, "content.xml", grep_inflated, &g);
+	if (!g.done)
+		grep_text(&g, strbuf_get(rest), strbuf_len(rest));
+	strbuf_free(rest);
+
+	if (opt_count) {
+		if (opt_num_filenames > 1) {
+			strbuf_append(g.out, filename);
+			strbuf_append_n(g.out, ":", 1);
+		}
+		snprintf(num, sizeof(num), "%lu\n", (unsigned long)g.count);
+		strbuf_append(g.out, num);
+	}
+
+	*count = g.count;
+	TRACE3(doc__done, doc_id, filename, strbuf_len(g.out));
+	return g.out;
+}
+
+/*
+ * Counts words and characters in a document formatted with marked
+ * headlines, leaving out the markers.  Newlines are not counted as
+ * characters.
+ */
+static void count_text(STRBUF *buf, struct doc_stats *stats)
+{
+	const unsigned char *p = (const unsigned char *)strbuf_get(buf);
+	const unsigned char *end = p + strbuf_len(buf);
+	int in_word = 0;
+
+	for (; p < end; p++) {
+		if (*p == IR_MARK) {
+			p++;       /* skip the underline character */
+			continue;
+		}
+		if (*p == IR_MARK_END || *p == '\n' || *p == ' ' || *p == '\t') {
+			if (*p == ' ' || *p == '\t')
+				stats->chars++;
+			in_word = 0;
+			continue;
+		}
+		if ((*p & 0xc0) == 0x80)
+			continue;
+		stats->chars++;
+		if (!in_word)
+			stats->words++;
+		in_word = 1;
+	}
+}
+
+/*
+ * Returns a line with the statistics of a document.  The document is
+ * only formatted; it is never wrapped or converted.
+ */
+static STRBUF *stats_file(const char *filename)
+{
+	struct stat st;
+	struct doc_stats stats = { 0, 0, 0, 0, 0 };
+	STRBUF *docbuf;
+	STRBUF *out;
+	char line[128];
+
+	if (0 != stat(filename, &st)) {
+		fprintf(stderr, "%s: %s\n",
+			filename, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	doc_id++;
+	TRACE3(doc__start, doc_id, filename, st.st_size);
+
+	docbuf = read_from_zip(filename, "content.xml");
+	TRACE2(format__start, doc_id, strbuf_len(docbuf));
+	format_markup(docbuf, 1, &stats);
+	format_text(docbuf);
+	TRACE2(format__done, doc_id, strbuf_len(docbuf));
+	count_text(docbuf, &stats);
+	strbuf_free(docbuf);
+
+	snprintf(line, sizeof(line), "%lu %lu %lu %lu %lu",
+		 (unsigned long)stats.words, (unsigned long)stats.chars,
+		 (unsigned long)stats.paragraphs,
+		 (unsigned long)stats.headlines,
+		 (unsigned long)stats.images);
+
+	out = strbuf_new();
+	strbuf_append(out, line);
+	if (opt_num_filenames > 1) {
+		strbuf_append_n(out, " ", 1);
+		strbuf_append(out, filename);
+	}
+	strbuf_append_n(out, "\n", 1);
+	TRACE3(doc__done, doc_id, filename, strbuf_len(out));
+	return out;
+}
+
+/*
+ * Collects the results of a batch conversion and writes them in the
+ * order of the file names on the command line.  A result holds the
+ * lengths of the outputs for all targets, followed by the outputs.
+ * The result of a search is a flag whether anything matched,
+ * followed by the output.
+ */
+struct batch {
+	size_t next;       /* index of the next result to write */
+	STRBUF **pending;  /* results that arrived too early */
+	char *failed;
+	int matched;
+};
+
+static STRBUF *batch_work(const char *filename, void *data)
+{
+	STRBUF *result = strbuf_new();
+	STRBUF **out;
+	size_t len;
+	size_t i;
+
+	strbuf_setopt(result, STRBUF_NULLOK);
+
+	if (opt_grep) {
+		STRBUF *lines = grep_file(filename, &len);
+
+		strbuf_append_n(result, len ? "1" : "0", 1);
+		strbuf_append_n(result, strbuf_get(lines), strbuf_len(lines));
+		strbuf_free(lines);
+		return result;
+	}
+
+	if (opt_stats) {
+		STRBUF *line = stats_file(filename);
+
+		strbuf_append_n(result, strbuf_get(line), strbuf_len(line));
+		strbuf_free(line);
+		return result;
+	}
+
+	out = ymalloc(num_targets * sizeof(STRBUF *));
+	convert(filename, out);
+
+	for (i = 0; i < num_targets; i++) {
+		len = strbuf_len(out[i]);
+		strbuf_append_n(result, (const char *)&len, sizeof(len));
+	}
+	for (i = 0; i < num_targets; i++) {
+		strbuf_append_n(result, strbuf_get(out[i]), strbuf_len(out[i]));
+		strbuf_free(out[i]);
+	}
+
+	yfree(out);
+	return result;
+}
+
+static void batch_write(struct batch *b, const char *result, size_t len)
+{
+	const char *data = result + num_targets * sizeof(size_t);
+	size_t i;
+
+	if (opt_grep) {
+		if (*result == '1')
+			b->matched = 1;
+		write_output(&targets[0], result + 1, len - 1);
+		return;
+	}
+
+	if (opt_stats) {
+		write_output(&targets[0], result, len);
+		return;
+	}
+
+	for (i = 0; i < num_targets; i++) {
+		memcpy(&len, result + i * sizeof(size_t), sizeof(len));
+		write_output(&targets[i], data, len);
+		data += len;
+	}
+}
+
+static void batch_done(size_t index, const char *result, size_t len,
+		       void *data)
+{
+	struct batch *b = data;
+
+	if (!result) {
+		fprintf(stderr, "%s: conversion failed\n",
+			opt_filenames[index]);
+		b->failed[index] = 1;
+	} else if (index != b->next) {
+		b->pending[index] = strbuf_new();
+		strbuf_append_n(b->pending[index], result, len);
+		return;
+	} else {
+		batch_write(b, result, len);
+	}
+
+	if (index != b->next)
+		return;
+
+	/* flush everything that was waiting for this result */
+	for (b->next++; b->next < opt_num_filenames; b->next++) {
+		STRBUF *p = b->pending[b->next];
+
+		if (p) {
+			batch_write(b, strbuf_get(p), strbuf_len(p));
+			strbuf_free(p);
+			b->pending[b->next] = NULL;
+		} else if (!b->failed[b->next]) {
+			break;
+		}
+	}
+}
+
+static size_t convert_batch(void)
+{
+	struct batch b;
+	size_t failed;
+	size_t i;
+
+	b.next = 0;
+	b.matched = 0;
+	b.pending = ymalloc(opt_num_filenames * sizeof(STRBUF *));
+	b.failed = ymalloc(opt_num_filenames);
+	for (i = 0; i < opt_num_filenames; i++) {
+		b.pending[i] = NULL;
+		b.failed[i] = 0;
+	}
+
+#ifndef NO_FORK
+	failed = pool_run(opt_jobs, opt_filenames, opt_num_filenames,
+			  batch_work, batch_done, &b);
+#else
+	/* without workers, a file which cannot be converted ends the
+	   batch */
+	for (i = 0; i < opt_num_filenames; i++) {
+		STRBUF *result = batch_work(opt_filenames[i], &b);
+
+		batch_done(i, strbuf_get(result), strbuf_len(result), &b);
+		strbuf_free(result);
+	}
+	failed = 0;
+#endif
+
+	yfree(b.pending);
+	yfree(b.failed);
+
+	/* like grep, a search without matches fails */
+	if (opt_grep && !b.matched && !failed)
+		failed = 1;
+	return failed;
+}
+
+static char *copy_arg(const char *arg)
+{
+	size_t arglen = strlen(arg) + 1;
+	char *copy = ymalloc(arglen);
+
+	memcpy(copy, arg, arglen);
+	return copy;
+}
+
+static int parse_width(const char *arg)
+{
+	int width = atoi(arg);
+
+	if(width < 3 && width != -1) {
+		fprintf(stderr, "Invalid value for width: %s\n", arg);
+		exit(EXIT_FAILURE);
+	}
+	return width;
+}
+
+static int parse_subst(const char *arg)
+{
+	if (!strcmp(arg, "none"))
+		return SUBST_NONE;
+	else if (!strcmp(arg, "some"))
+		return SUBST_SOME;
+	else if (!strcmp(arg, "all"))
+		return SUBST_ALL;
+
+	fprintf(stderr, "Invalid value for --subst: %s\n", arg);
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * Parses the argument of --target.  Values which are not given are
+ * marked as unset and filled in after all options have been read.
+ */
+static void parse_target(const char *arg)
+{
+	struct target *t = &targets[num_targets++];
+	char *spec = copy_arg(arg);
+	char *tok;
+
+	t->encoding = NULL;
+	t->width = 0;
+	t->subst = -1;
+	t->output = NULL;
+	t->cs = NULL;
+	t->same = 0;
+	t->index = NULL;
+
+	for (tok = strtok(spec, ","); tok; tok = strtok(NULL, ",")) {
+		if (!strncmp(tok, "encoding=", 9))
+			t->encoding = copy_arg(tok + 9);
+		else if (!strncmp(tok, "width=", 6))
+			t->width = parse_width(tok + 6);
+		else if (!strncmp(tok, "subst=", 6))
+			t->subst = parse_subst(tok + 6);
+		else if (!strncmp(tok, "output=", 7))
+			t->output = copy_arg(tok + 7);
+		else {
+			fprintf(stderr, "Invalid value for --target: %s\n", arg);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	yfree(spec);
+}
+
+/*
+ * Parses the argument of --paragraphs or --headlines, which is N or
+ * N-M.
+ */
+static void parse_range(const char *opt, const char *arg)
+{
+	char *end;
+
+	opt_range_first = (size_t)strtoul(arg, &end, 10);
+	opt_range_last = opt_range_first;
+	if (*end == '-' && end[1] >= '0' && end[1] <= '9')
+		opt_range_last = (size_t)strtoul(end + 1, &end, 10);
+	if (*end || !opt_range_first || opt_range_last < opt_range_first) {
+		fprintf(stderr, "Invalid value for %s: %s\n", opt, arg);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * Returns the name of the index next to the text in filename.
+ */
+static char *index_path(const char *filename)
+{
+	size_t len = strlen(filename) + 5;
+	char *path = ymalloc(len);
+
+	snprintf(path, len, "%s.idx", filename);
+	return path;
+}
+
+static void write_index(struct target *t)
+{
+	char *path = index_path(t->output);
+	int fd = open_output(path);
+
+	write_fd(fd, path, strbuf_get(t->index), strbuf_len(t->index));
+	close(fd);
+	yfree(path);
+}
+
+/*
+ * Writes the paragraphs or sections selected by --paragraphs or
+ * --headlines from the text in filename to fd.  The index tells
+ * where they are, and they are read with a single pread.
+ */
+static void lookup_text(const char *filename, int fd)
+{
+	struct paraidx idx;
+	STRBUF *buf;
+	char *path = index_path(filename);
+	char readbuf[4096];
+	size_t start, end, len;
+	ssize_t r;
+	char *text;
+	int tfd;
+
+	tfd = open(path, O_RDONLY);
+	if (tfd == -1) {
+		fprintf(stderr, "Can't open %s: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	buf = strbuf_new();
+	strbuf_setopt(buf, STRBUF_NULLOK);
+	while ((r = read(tfd, readbuf, sizeof(readbuf))) > 0)
+		strbuf_append_n(buf, readbuf, (size_t)r);
+	close(tfd);
+	if (r == -1 || paraidx_decode(&idx, strbuf_get(buf),
+				      strbuf_len(buf)) == -1) {
+		fprintf(stderr, "%s: Invalid index\n", path);
+		exit(EXIT_FAILURE);
+	}
+	strbuf_free(buf);
+
+	if (paraidx_range(&idx, opt_range_headlines, opt_range_first,
+			  opt_range_last, &start, &end) == -1) {
+		fprintf(stderr, "%s: No %s %lu\n", filename,
+			opt_range_headlines ? "headline" : "paragraph",
+			(unsigned long)opt_range_first);
+		exit(EXIT_FAILURE);
+	}
+	paraidx_free(&idx);
+
+	tfd = open(filename, O_RDONLY);
+	if (tfd == -1) {
+		fprintf(stderr, "Can't open %s: %s\n", filename,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	len = end - start;
+	text = ymalloc(len + 1);
+	r = pread(tfd, text, len, (off_t)start);
+	if (r != (ssize_t)len) {
+		fprintf(stderr, "%s: %s\n", filename,
+			r == -1 ? strerror(errno) : "Text is shorter than its index");
+		exit(EXIT_FAILURE);
+	}
+	close(tfd);
+
+	write_fd(fd, opt_output ? opt_output : "stdout", text, len);
+	yfree(text);
+	yfree(path);
+}
+
+static int is_odf_name(const char *name)
+{
+	const char *ext = strrchr(name, '.');
+
+	return ext && strlen(ext) == 4 &&
+		(!strncmp(ext, ".od", 3) || !strncmp(ext, ".ot", 3) ||
+		 !strncmp(ext, ".sx", 3) || !strncmp(ext, ".st", 3));
+}
+
+/*
+ * Adds a file to convert.  Directories are searched recursively for
+ * OpenDocument files in alphabetical order.  found is set for files
+ * which have been found in a directory rather than named on the
+ * command line.  Links to files are followed when searching, links
+ * to directories are not, so that the search cannot loop.
+ */
+static void add_filename(const char *filename, int found)
+{
+	struct stat st;
+	struct dirent **entries;
+	size_t len;
+	char *path;
+	int n, i, r;
+
+#ifdef S_ISLNK
+	r = found ? lstat(filename, &st) : stat(filename, &st);
+	if (r == 0 && S_ISLNK(st.st_mode))
+		r = stat(filename, &st) == 0 && !S_ISDIR(st.st_mode) ? 0 : -1;
+#else
+	r = stat(filename, &st);
+#endif
+
+	/* a named file which cannot be read is reported by convert */
+	if (r == 0 && S_ISDIR(st.st_mode)) {
+		n = scandir(filename, &entries, NULL, alphasort);
+		if (n == -1) {
+			fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		for (i = 0; i < n; i++) {
+			if (entries[i]->d_name[0] != '.') {
+				len = strlen(filename) + strlen(entries[i]->d_name) + 2;
+				path = ymalloc(len);
+				snprintf(path, len, "%s/%s", filename,
+					 entries[i]->d_name);
+				add_filename(path, 1);
+			}
+			free(entries[i]);
+		}
+		free(entries);
+		yfree((char *)filename);
+		return;
+	}
+
+	if (found && (r != 0 || !S_ISREG(st.st_mode) ||
+		      !is_odf_name(filename))) {
+		yfree((char *)filename);
+		return;
+	}
+
+	if (opt_num_filenames == opt_filenames_size) {
+		opt_filenames_size = opt_filenames_size ? opt_filenames_size << 1 : 16;
+		opt_filenames = yrealloc(opt_filenames,
+					 opt_filenames_size * sizeof(const char *));
+	}
+	opt_filenames[opt_num_filenames++] = filename;
+}
+
+int main(int argc, const char **argv)
+{
+	STRBUF **out;
+	struct target *t;
+	int ret = EXIT_SUCCESS;
+	int have_files = 0;
+	size_t n;
+	int i = 1;
+
+	(void)setlocale(LC_ALL, "");
+
+	targets = ymalloc(argc * sizeof(struct target));
+
+	while (argv[i]) {
+		if (!strcmp(argv[i], "--raw")) {
+			opt_raw = 1;
+			i++; continue;
+		} else if (!strncmp(argv[i], "--encoding=", 11)) {
+#ifdef iconvlist
+			if (!strcmp(argv[i] + 11, "list")) {
+				show_iconvlist();
+			}
 #endif
-			opt_encoding = ymalloc(arglen);
-			memcpy(opt_encoding, argv[i] + 11, arglen);
+			opt_encoding = copy_arg(argv[i] + 11);
 			i++; continue;
 		} else if (!strncmp(argv[i], "--width=", 8)) {
-			opt_width = atoi(argv[i] + 8);
-			if(opt_width < 3 && opt_width != -1) {
-				fprintf(stderr, "Invalid value for width: %s\n",
-					argv[i] + 8);
-				exit(EXIT_FAILURE);
-			}
+			opt_width = parse_width(argv[i] + 8);
 			i++; continue;
 		} else if (!strcmp(argv[i], "--force")) {
 			// ignore this setting
 			i++; continue;
 		} else if (!strncmp(argv[i], "--output=", 9)) {
-			if (*(argv[i] + 9) != '-') {
-				size_t arglen = strlen(argv[i]) - 8;
-				opt_output = ymalloc(arglen);
-				memcpy(opt_output, argv[i] + 9, arglen);
+			if (*(argv[i] + 9) != '-')
+				opt_output = copy_arg(argv[i] + 9);
+			i++; continue;
+		} else if (!strncmp(argv[i], "--cache=", 8)) {
+			opt_cache = copy_arg(argv[i] + 8);
+			i++; continue;
+		} else if (!strncmp(argv[i], "--target=", 9)) {
+			parse_target(argv[i] + 9);
+			i++; continue;
+		} else if (!strncmp(argv[i], "--chunk-size=", 13)) {
+			int size = atoi(argv[i] + 13);
+			if (size < 1) {
+				fprintf(stderr, "Invalid value for chunk size: %s\n",
+					argv[i] + 13);
+				exit(EXIT_FAILURE);
 			}
+			opt_chunk_size = (size_t)size;
 			i++; continue;
-		} else if (!strncmp(argv[i], "--subst=", 8)) {
-			if (!strcmp(argv[i] + 8, "none"))
-				opt_subst = SUBST_NONE;
-			else if (!strcmp(argv[i] + 8, "some"))
-				opt_subst = SUBST_SOME;
-			else if (!strcmp(argv[i] + 8, "all"))
-				opt_subst = SUBST_ALL;
-			else {
-				fprintf(stderr, "Invalid value for --subst: %s\n",
-					argv[i] + 8);
+		} else if (!strncmp(argv[i], "--grep=", 7)) {
+			opt_grep = copy_arg(argv[i] + 7);
+			i++; continue;
+		} else if (!strcmp(argv[i], "--count")) {
+			opt_count = 1;
+			i++; continue;
+		} else if (!strcmp(argv[i], "--first")) {
+			opt_first = 1;
+			i++; continue;
+		} else if (!strcmp(argv[i], "--stats-only")) {
+			opt_stats = 1;
+			i++; continue;
+		} else if (!strcmp(argv[i], "--index")) {
+			opt_index = 1;
+			i++; continue;
+		} else if (!strcmp(argv[i], "--profile")) {
+			opt_profile = 1;
+			i++; continue;
+		} else if (!strcmp(argv[i], "--slides")) {
+			opt_slides = 1;
+			i++; continue;
+		} else if (!strcmp(argv[i], "--objects")) {
+			opt_objects = 1;
+			i++; continue;
+		} else if (!strncmp(argv[i], "--lookup=", 9)) {
+			opt_lookup = copy_arg(argv[i] + 9);
+			i++; continue;
+		} else if (!strncmp(argv[i], "--paragraphs=", 13)) {
+			parse_range("--paragraphs", argv[i] + 13);
+			opt_range_headlines = 0;
+			i++; continue;
+		} else if (!strncmp(argv[i], "--headlines=", 12)) {
+			parse_range("--headlines", argv[i] + 12);
+			opt_range_headlines = 1;
+			i++; continue;
+		} else if (!strncmp(argv[i], "--jobs=", 7)) {
+			opt_jobs = atoi(argv[i] + 7);
+			if (opt_jobs < 1) {
+				fprintf(stderr, "Invalid value for jobs: %s\n",
+					argv[i] + 7);
 				exit(EXIT_FAILURE);
 			}
 			i++; continue;
+		} else if (!strncmp(argv[i], "--subst=", 8)) {
+			opt_subst = parse_subst(argv[i] + 8);
+			i++; continue;
 		} else if (!strcmp(argv[i], "--help")) {
 			usage();
 		} else if (!strcmp(argv[i], "--version")
@@ -529,9 +3020,8 @@ int main(int argc, const char **argv)
 		} else if (!strcmp(argv[i], "-")) {
 			usage();
 		} else {
-			if(opt_filename)
-				usage();
-			opt_filename = argv[i];
+			add_filename(copy_arg(argv[i]), 0);
+			have_files = 1;
 			i++; continue;
 		}
 	}
@@ -544,61 +3034,213 @@ int main(int argc, const char **argv)
 		exit(EXIT_SUCCESS);
 	}
 
+	if (opt_lookup) {
+		int fd;
+
+		if (!opt_range_first || have_files || num_targets)
+			usage();
+		fd = open_output(opt_output);
+		lookup_text(opt_lookup, fd);
+		if (opt_output) {
+			close(fd);
+			yfree(opt_output);
+		}
+		yfree(opt_lookup);
+		yfree(targets);
+		exit(EXIT_SUCCESS);
+	}
+
 	if(opt_raw)
 		opt_width = -1;
 
-	if(!opt_filename)
+	if(!have_files)
 		usage();
 
-	if(!opt_encoding) {
-		opt_encoding = guess_encoding();
+	if (!opt_num_filenames) {
+		fprintf(stderr, "No OpenDocument files found.\n");
+		exit(EXIT_FAILURE);
 	}
 
-	ic = init_conv("UTF-8", opt_encoding);
+	if (opt_grep) {
+		char err[256];
 
-	if (0 != stat(opt_filename, &st)) {
-		fprintf(stderr, "%s: %s\n",
-			opt_filename, strerror(errno));
+		grep_rx = rx_compile(opt_grep, RX_NEWLINE | RX_POSIX, err,
+				     sizeof(err));
+		if (!grep_rx) {
+			fprintf(stderr, "Invalid value for --grep: %s\n", err);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (opt_jobs < 1) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		opt_jobs = n > 0 ? (int)n : 1;
+	}
+	/* several files keep the processors busy with workers */
+	if (opt_num_filenames == 1)
+		conv_threads = opt_jobs;
+
+	/* without --target, the options describe a single target */
+	if (!num_targets) {
+		parse_target("");
+		targets[0].output = opt_output;
+		opt_output = NULL;
+	}
+
+	for (n = 0; n < num_targets; n++) {
+		size_t k;
+
+		t = &targets[n];
+		if (!t->output && opt_output)
+			t->output = copy_arg(opt_output);
+		/* opening an output again would truncate it */
+		for (k = 0; k < n; k++) {
+			if (!t->output != !targets[k].output ||
+			    (t->output && strcmp(t->output, targets[k].output)))
+				continue;
+			fprintf(stderr, "Output %s is used by two targets\n",
+				t->output ? t->output : "stdout");
+			exit(EXIT_FAILURE);
+		}
+		if (!t->encoding)
+			t->encoding = opt_encoding ? copy_arg(opt_encoding)
+						   : guess_encoding();
+		if (!t->width || opt_raw)
+			t->width = opt_width;
+		if (t->subst == -1)
+			t->subst = opt_subst;
+
+#ifndef NO_ICONV
+		t->cs = charset_find(t->encoding);
+#endif
+		if (!t->cs)
+			t->ic = init_conv("UTF-8", t->encoding);
+		t->same = !t->cs && is_utf8(t->encoding);
+
+		if (opt_index && !t->output) {
+			fprintf(stderr, "--index needs an output file\n");
+			exit(EXIT_FAILURE);
+		}
+		if (opt_index && !t->cs && !is_stateless(t->encoding)) {
+			fprintf(stderr, "--index does not work with encoding %s\n",
+				t->encoding);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (opt_index && (opt_num_filenames != 1 || opt_grep || opt_stats ||
+			  opt_chunk_size)) {
+		fprintf(stderr, "--index needs a single file and no --grep, "
+			"--stats-only or --chunk-size\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* they write a single output */
+	if ((opt_grep || opt_stats) && num_targets != 1) {
+		fprintf(stderr, "--grep and --stats-only need a single "
+			"target\n");
 		exit(EXIT_FAILURE);
 	}
 
-	/* read content.xml */
-	docbuf = read_from_zip(opt_filename, "content.xml");
+	if ((opt_grep ? 1 : 0) + opt_stats + (opt_chunk_size ? 1 : 0) > 1) {
+		fprintf(stderr, "--grep, --stats-only and --chunk-size cannot "
+			"be combined\n");
+		exit(EXIT_FAILURE);
+	}
 
-	if (!opt_raw) {
-		subst_doc(ic, docbuf);
-		format_doc(docbuf);
+	if (opt_slides && (num_targets != 1 || opt_cache || opt_raw ||
+			   opt_index)) {
+		fprintf(stderr, "--slides needs a single target and no --cache, "
+			"--raw or --index\n");
+		exit(EXIT_FAILURE);
 	}
 
-	wbuf = wrap(docbuf, opt_width);
+	if (opt_objects && (num_targets != 1 || opt_cache || opt_raw ||
+			    opt_slides || opt_index)) {
+		fprintf(stderr, "--objects needs a single target and no "
+			"--cache, --raw, --slides or --index\n");
+		exit(EXIT_FAILURE);
+	}
 
-	/* remove all trailing whitespace */
-	(void) regex_subst(wbuf, " +\n", _REG_GLOBAL, "\n");
+	/* the workers of a batch would keep the counts to themselves */
+	if (opt_profile && opt_num_filenames != 1) {
+		fprintf(stderr, "--profile needs a single file\n");
+		exit(EXIT_FAILURE);
+	}
 
-	outbuf = conv(ic, wbuf);
+	/* the outputs are opened only once a single file has been
+	   converted, so that a failure leaves them alone */
+	if (opt_num_filenames == 1 && opt_grep) {
+		STRBUF *lines = grep_file(opt_filenames[0], &n);
+		open_outputs();
+		write_output(&targets[0], strbuf_get(lines), strbuf_len(lines));
+		strbuf_free(lines);
+		if (!n)
+			ret = EXIT_FAILURE;
+	} else if (opt_num_filenames == 1 && opt_stats) {
+		STRBUF *line = stats_file(opt_filenames[0]);
+		open_outputs();
+		write_output(&targets[0], strbuf_get(line), strbuf_len(line));
+		strbuf_free(line);
+	} else if (opt_num_filenames == 1) {
+		out = ymalloc(num_targets * sizeof(STRBUF *));
+		convert(opt_filenames[0], out);
+		open_outputs();
+		for (n = 0; n < num_targets; n++) {
+			write_output(&targets[n], strbuf_get(out[n]),
+				     strbuf_len(out[n]));
+			strbuf_free(out[n]);
+			if (targets[n].index) {
+				write_index(&targets[n]);
+				strbuf_free(targets[n].index);
+			}
+		}
+		yfree(out);
+	} else {
+		open_outputs();
+		if (convert_batch())
+			ret = EXIT_FAILURE;
+	}
 
-	if (opt_output)
-		write_to_file(outbuf, opt_output);
-	else
-		fwrite(strbuf_get(outbuf), strbuf_len(outbuf), 1, stdout);
+	if (opt_profile)
+		print_rule_costs();
 
-	finish_conv(ic);
-	strbuf_free(wbuf);
-	strbuf_free(docbuf);
-	strbuf_free(outbuf);
-#ifndef NO_ICONV
-	yfree(opt_encoding);
-#endif
+	for (n = 0; n < num_targets; n++) {
+		t = &targets[n];
+		if (!t->cs)
+			finish_conv(t->ic);
+		if (t->output) {
+			close(t->fd);
+			yfree(t->output);
+		}
+		if (t->encoding)
+			yfree(t->encoding);
+	}
+	yfree(targets);
+	for (n = 0; n < opt_num_filenames; n++)
+		yfree((char *)opt_filenames[n]);
+	yfree(opt_filenames);
+	if (opt_grep) {
+		rx_free(grep_rx);
+		yfree(opt_grep);
+	}
+	if (opt_encoding)
+		yfree(opt_encoding);
 	if (opt_output)
 		yfree(opt_output);
+	if (opt_cache)
+		yfree(opt_cache);
+	strbuf_pool_flush();
 
-	return EXIT_SUCCESS;
+	return ret;
 }
 
-static void write_to_file(STRBUF *outbuf, const char *filename)
+static int open_output(const char *filename)
 {
 	int fd;
-	ssize_t len;
+
+	if (!filename)
+		return STDOUT_FILENO;
 
 	fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
 	if (fd == -1) {
@@ -606,13 +3248,38 @@ static void write_to_file(STRBUF *outbuf, const char *filename)
 		exit(EXIT_FAILURE);
 	}
 
-	len = write(fd, strbuf_get(outbuf), strbuf_len(outbuf));
-	if (len == -1) {
-		fprintf(stderr, "Can't write to %s: %s\n", filename, strerror(errno));
-		exit(EXIT_FAILURE);
+	return fd;
+}
+
+static void open_outputs(void)
+{
+	size_t n;
+
+	for (n = 0; n < num_targets; n++)
+		targets[n].fd = open_output(targets[n].output);
+}
+
+static void write_fd(int fd, const char *name, const char *data, size_t len)
+{
+	ssize_t r;
+
+	while (len) {
+		r = write(fd, data, len);
+		if (r == -1 && errno == EINTR)
+			continue;
+		if (r == -1) {
+			fprintf(stderr, "Can't write to %s: %s\n",
+				name, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		data += r;
+		len -= (size_t)r;
 	}
+}
 
-	close(fd);
+static void write_output(struct target *t, const char *data, size_t len)
+{
+	write_fd(t->fd, t->output ? t->output : "stdout", data, len);
 }
 
 
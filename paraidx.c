@@ -0,0 +1,157 @@
+/*
+ * paraidx.c: Paragraph index of converted text
+ *
+ * Copyright (c) 2006-2009 Dennis Stosberg <dennis@stosberg.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2 as published by the Free Software Foundation
+ */
+
+#include <string.h>
+
+#include "ir.h"
+#include "mem.h"
+#include "paraidx.h"
+
+static const char idx_magic[] = "odt2txt-idx";
+static const unsigned char idx_version = 1;
+
+void paraidx_init(struct paraidx *idx)
+{
+	idx->count = 0;
+	idx->size = 0;
+	idx->offsets = NULL;
+	idx->headline = NULL;
+}
+
+void paraidx_free(struct paraidx *idx)
+{
+	if (idx->offsets)
+		yfree(idx->offsets);
+	if (idx->headline)
+		yfree(idx->headline);
+	paraidx_init(idx);
+}
+
+/* makes room for n paragraphs and the end */
+static void reserve(struct paraidx *idx, size_t n)
+{
+	if (n < idx->size)
+		return;
+	while (idx->size <= n)
+		idx->size = idx->size ? idx->size << 1 : 64;
+	idx->offsets = yrealloc(idx->offsets, idx->size * sizeof(size_t));
+	idx->headline = yrealloc(idx->headline, idx->size);
+}
+
+void paraidx_add(struct paraidx *idx, size_t offset, int headline)
+{
+	reserve(idx, idx->count + 1);
+	idx->offsets[idx->count] = offset;
+	idx->headline[idx->count] = headline ? 1 : 0;
+	idx->count++;
+	idx->offsets[idx->count] = offset;
+}
+
+void paraidx_end(struct paraidx *idx, size_t offset)
+{
+	reserve(idx, idx->count);
+	idx->offsets[idx->count] = offset;
+}
+
+STRBUF *paraidx_encode(const struct paraidx *idx)
+{
+	STRBUF *buf = strbuf_new();
+	size_t prev = 0;
+	size_t i;
+
+	strbuf_setopt(buf, STRBUF_NULLOK);
+	strbuf_append_n(buf, idx_magic, sizeof(idx_magic));
+	strbuf_append_n(buf, (const char *)&idx_version, 1);
+	ir_put_varint(buf, idx->count);
+
+	for (i = 0; i < idx->count; i++) {
+		ir_put_varint(buf, (unsigned long long)(idx->offsets[i] - prev) << 1
+			      | idx->headline[i]);
+		prev = idx->offsets[i];
+	}
+	ir_put_varint(buf, idx->size ? idx->offsets[i] - prev : 0);
+
+	return buf;
+}
+
+int paraidx_decode(struct paraidx *idx, const char *data, size_t len)
+{
+	const char *p = data;
+	const char *end = data + len;
+	unsigned long long v, count;
+	size_t offset = 0;
+	size_t i;
+
+	paraidx_init(idx);
+	if (len < sizeof(idx_magic) + 1 ||
+	    memcmp(data, idx_magic, sizeof(idx_magic)) ||
+	    (unsigned char)data[sizeof(idx_magic)] != idx_version)
+		return -1;
+	p += sizeof(idx_magic) + 1;
+
+	/* every paragraph takes at least one byte */
+	if (ir_get_varint(&p, end, &count) == -1 ||
+	    count > (unsigned long long)(end - p))
+		return -1;
+
+	for (i = 0; i < count; i++) {
+		if (ir_get_varint(&p, end, &v) == -1) {
+			paraidx_free(idx);
+			return -1;
+		}
+		offset += (size_t)(v >> 1);
+		paraidx_add(idx, offset, (int)(v & 1));
+	}
+	if (ir_get_varint(&p, end, &v) == -1 || p != end) {
+		paraidx_free(idx);
+		return -1;
+	}
+	paraidx_end(idx, offset + (size_t)v);
+
+	return 0;
+}
+
+/*
+ * Returns the paragraph of headline n, counted from 1, or the number
+ * of paragraphs if there are fewer headlines.
+ */
+static size_t headline_para(const struct paraidx *idx, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < idx->count; i++)
+		if (idx->headline[i] && !--n)
+			break;
+	return i;
+}
+
+int paraidx_range(const struct paraidx *idx, int headlines,
+		  size_t first, size_t last, size_t *start, size_t *end)
+{
+	size_t from, to;
+
+	if (!first || last < first)
+		return -1;
+
+	if (headlines) {
+		from = headline_para(idx, first);
+		to = last < idx->count ? headline_para(idx, last + 1)
+				       : idx->count;
+	} else {
+		from = first - 1;
+		to = last < idx->count ? last : idx->count;
+	}
+	if (from >= idx->count)
+		return -1;
+
+	*start = idx->offsets[from];
+	*end = idx->offsets[to];
+	return 0;
+}
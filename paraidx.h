@@ -0,0 +1,64 @@
+/*
+ * paraidx.h: Paragraph index of converted text
+ *
+ * Copyright (c) 2006-2009 Dennis Stosberg <dennis@stosberg.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2 as published by the Free Software Foundation
+ */
+
+#ifndef PARAIDX_H
+#define PARAIDX_H
+
+#include <stddef.h>
+
+#include "strbuf.h"
+
+/*
+ * The byte offsets of the paragraphs in a converted text, kept in a
+ * sidecar file next to it.  The file is a magic string, a version
+ * byte, the number of paragraphs and then one varint per paragraph:
+ * its distance to the previous one, shifted left by one, with the
+ * lowest bit set for headlines.  A last varint is the distance from
+ * the last paragraph to the end of the text.
+ */
+struct paraidx {
+	size_t count;             /* number of paragraphs */
+	size_t size;
+	size_t *offsets;          /* count + 1, the last is the end */
+	unsigned char *headline;  /* count */
+};
+
+void paraidx_init(struct paraidx *idx);
+void paraidx_free(struct paraidx *idx);
+
+/*
+ * Adds the next paragraph at offset.  Offsets must not decrease.
+ */
+void paraidx_add(struct paraidx *idx, size_t offset, int headline);
+
+/*
+ * Sets the end of the text.  Must be called after the last paragraph
+ * has been added.
+ */
+void paraidx_end(struct paraidx *idx, size_t offset);
+
+STRBUF *paraidx_encode(const struct paraidx *idx);
+
+/*
+ * Decodes an index from data.  Returns -1 if it is corrupted.
+ */
+int paraidx_decode(struct paraidx *idx, const char *data, size_t len);
+
+/*
+ * Finds the bytes [*start, *end) which hold the paragraphs first to
+ * last, counted from 1.  If headlines is set, they are the sections
+ * which start with the first to the last headline instead.  last is
+ * capped at the number of paragraphs or headlines.  Returns -1 if
+ * first is not in the text.
+ */
+int paraidx_range(const struct paraidx *idx, int headlines,
+		  size_t first, size_t last, size_t *start, size_t *end);
+
+#endif /* PARAIDX_H */
@@ -0,0 +1,308 @@
+/*
+ * pool.c: A pool of pre-forked worker processes
+ *
+ * Copyright (c) 2006-2009 Dennis Stosberg <dennis@stosberg.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2 as published by the Free Software Foundation
+ */
+
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "mem.h"
+#include "pool.h"
+
+#define NO_JOB ((size_t)-1)
+
+struct worker {
+	pid_t  pid;
+	int    job_fd;   /* parent writes job numbers here */
+	int    res_fd;   /* parent reads result headers from here */
+	int    shm_fd;   /* result data, shared with the parent */
+	size_t job;      /* job in progress or NO_JOB */
+};
+
+struct result {
+	size_t index;
+	size_t len;
+};
+
+static struct worker *workers;
+static int num_workers;
+
+static void die(const char *msg)
+{
+	fprintf(stderr, "%s: %s\n", msg, strerror(errno));
+	exit(EXIT_FAILURE);
+}
+
+static int read_full(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+	ssize_t r;
+
+	while (len) {
+		r = read(fd, p, len);
+		if (r == -1 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return -1;
+		p += r;
+		len -= (size_t)r;
+	}
+	return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t r;
+
+	while (len) {
+		r = write(fd, p, len);
+		if (r == -1 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return -1;
+		p += r;
+		len -= (size_t)r;
+	}
+	return 0;
+}
+
+/*
+ * Creates an unlinked temporary file, which is shared between a
+ * worker and the parent.  The descriptor survives the replacement
+ * of a dead worker.
+ */
+static int shm_create(void)
+{
+	const char *dir = getenv("TMPDIR");
+	char *name;
+	size_t len;
+	int fd;
+
+	if (!dir || !*dir)
+		dir = "/tmp";
+
+	len = strlen(dir) + sizeof("/odt2txt.XXXXXX");
+	name = ymalloc(len);
+	snprintf(name, len, "%s/odt2txt.XXXXXX", dir);
+
+	fd = mkstemp(name);
+	if (fd == -1)
+		die("Can't create shared memory file");
+	unlink(name);
+	yfree(name);
+
+	return fd;
+}
+
+static void worker_loop(struct worker *w, const char **jobs,
+			pool_work_fn work, void *data)
+{
+	struct result res;
+	STRBUF *out;
+	void *map;
+
+	while (read_full(w->job_fd, &res.index, sizeof(res.index)) == 0) {
+		out = work(jobs[res.index], data);
+		res.len = strbuf_len(out);
+
+		if (ftruncate(w->shm_fd, (off_t)res.len) == -1)
+			die("Can't resize shared memory");
+		if (res.len) {
+			map = mmap(NULL, res.len, PROT_READ | PROT_WRITE,
+				   MAP_SHARED, w->shm_fd, 0);
+			if (map == MAP_FAILED)
+				die("Can't map shared memory");
+			memcpy(map, strbuf_get(out), res.len);
+			munmap(map, res.len);
+		}
+		strbuf_free(out);
+		strbuf_pool_trim();
+
+		if (write_full(w->res_fd, &res, sizeof(res)) == -1)
+			break;
+	}
+	strbuf_pool_flush();
+	exit(EXIT_SUCCESS);
+}
+
+static void worker_start(struct worker *w, const char **jobs,
+			 pool_work_fn work, void *data)
+{
+	int job_pipe[2], res_pipe[2];
+	int i;
+
+	if (pipe(job_pipe) == -1 || pipe(res_pipe) == -1)
+		die("Can't create pipe");
+
+	/* don't let the worker inherit unflushed output */
+	fflush(stdout);
+	fflush(stderr);
+
+	w->pid = fork();
+	if (w->pid == -1)
+		die("Can't fork worker");
+
+	if (w->pid == 0) {
+		/* a worker must not hold the pipes of its siblings,
+		   or their deaths would go unnoticed */
+		for (i = 0; i < num_workers; i++) {
+			if (&workers[i] == w || workers[i].pid <= 0)
+				continue;
+			close(workers[i].job_fd);
+			close(workers[i].res_fd);
+			close(workers[i].shm_fd);
+		}
+		close(job_pipe[1]);
+		close(res_pipe[0]);
+		w->job_fd = job_pipe[0];
+		w->res_fd = res_pipe[1];
+		worker_loop(w, jobs, work, data);
+	}
+
+	close(job_pipe[0]);
+	close(res_pipe[1]);
+	w->job_fd = job_pipe[1];
+	w->res_fd = res_pipe[0];
+	w->job = NO_JOB;
+}
+
+static void worker_stop(struct worker *w)
+{
+	int status;
+
+	close(w->job_fd);
+	close(w->res_fd);
+	while (waitpid(w->pid, &status, 0) == -1 && errno == EINTR)
+		;
+	w->pid = 0;
+}
+
+static int worker_assign(struct worker *w, size_t job)
+{
+	w->job = job;
+	return write_full(w->job_fd, &job, sizeof(job));
+}
+
+/*
+ * Hands the shared result of w to done.  Returns -1 if the
+ * worker has died.
+ */
+static int worker_collect(struct worker *w, pool_done_fn done, void *data)
+{
+	struct result res;
+	void *map = NULL;
+
+	if (read_full(w->res_fd, &res, sizeof(res)) == -1)
+		return -1;
+
+	if (res.len) {
+		map = mmap(NULL, res.len, PROT_READ, MAP_SHARED, w->shm_fd, 0);
+		if (map == MAP_FAILED)
+			die("Can't map shared memory");
+	}
+	done(res.index, map ? (const char *)map : "", res.len, data);
+	if (map)
+		munmap(map, res.len);
+
+	w->job = NO_JOB;
+	return 0;
+}
+
+size_t pool_run(int nworkers, const char **jobs, size_t njobs,
+		pool_work_fn work, pool_done_fn done, void *data)
+{
+	void (*old_sigpipe)(int);
+	size_t next_job = 0;
+	size_t finished = 0;
+	size_t failed = 0;
+	int i;
+
+	if (nworkers < 1)
+		nworkers = 1;
+	if ((size_t)nworkers > njobs)
+		nworkers = (int)njobs;
+	if (!nworkers)
+		return 0;
+
+	/* a dead worker is noticed on its result pipe, not by a signal */
+	old_sigpipe = signal(SIGPIPE, SIG_IGN);
+
+	num_workers = nworkers;
+	workers = ymalloc(nworkers * sizeof(struct worker));
+	for (i = 0; i < nworkers; i++) {
+		workers[i].pid = 0;
+		workers[i].shm_fd = shm_create();
+	}
+	for (i = 0; i < nworkers; i++)
+		worker_start(&workers[i], jobs, work, data);
+
+	while (finished < njobs) {
+		fd_set rfds;
+		int maxfd = -1;
+
+		/* keep every worker busy */
+		for (i = 0; i < nworkers; i++) {
+			struct worker *w = &workers[i];
+
+			if (w->job != NO_JOB || next_job == njobs)
+				continue;
+			if (worker_assign(w, next_job++) == -1) {
+				/* picked up again on the result pipe */
+				continue;
+			}
+		}
+
+		FD_ZERO(&rfds);
+		for (i = 0; i < nworkers; i++) {
+			if (workers[i].job == NO_JOB)
+				continue;
+			FD_SET(workers[i].res_fd, &rfds);
+			if (workers[i].res_fd > maxfd)
+				maxfd = workers[i].res_fd;
+		}
+
+		if (select(maxfd + 1, &rfds, NULL, NULL, NULL) == -1) {
+			if (errno == EINTR)
+				continue;
+			die("select failed");
+		}
+
+		for (i = 0; i < nworkers; i++) {
+			struct worker *w = &workers[i];
+
+			if (w->job == NO_JOB || !FD_ISSET(w->res_fd, &rfds))
+				continue;
+
+			if (worker_collect(w, done, data) == -1) {
+				done(w->job, NULL, 0, data);
+				failed++;
+				worker_stop(w);
+				worker_start(w, jobs, work, data);
+			}
+			finished++;
+		}
+	}
+
+	for (i = 0; i < nworkers; i++) {
+		worker_stop(&workers[i]);
+		close(workers[i].shm_fd);
+	}
+	yfree(workers);
+	workers = NULL;
+	num_workers = 0;
+
+	signal(SIGPIPE, old_sigpipe);
+	return failed;
+}
@@ -0,0 +1,45 @@
+/*
+ * pool.c: A pool of pre-forked worker processes
+ *
+ * Copyright (c) 2006-2009 Dennis Stosberg <dennis@stosberg.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2 as published by the Free Software Foundation
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+#include "strbuf.h"
+
+/*
+ * Converts a single job in a worker process.  The function may call
+ * exit() at any time; the job is then reported as failed and the
+ * worker is replaced.
+ */
+typedef STRBUF *(*pool_work_fn)(const char *job, void *data);
+
+/*
+ * Receives the result of job number index in the parent process.
+ * result points into shared memory and is only valid during the
+ * call.  result is NULL if the worker died while converting the job.
+ */
+typedef void (*pool_done_fn)(size_t index, const char *result,
+			     size_t len, void *data);
+
+/*
+ * Runs njobs jobs on nworkers worker processes, which are forked once
+ * and kept running until all jobs are done.  Jobs are handed to the
+ * workers through pipes, results come back through a shared memory
+ * mapping per worker.  done is called in the parent for every job,
+ * not necessarily in the order of jobs.
+ *
+ * Returns the number of failed jobs.
+ */
+size_t pool_run(int nworkers, const char **jobs, size_t njobs,
+		pool_work_fn work, pool_done_fn done, void *data);
+
+#endif /* POOL_H */
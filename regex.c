@@ -8,6 +8,16 @@
  * version 2 as published by the Free Software Foundation
  */
 
+#include <ctype.h>
+#ifndef NO_THREADS
+#  include <pthread.h>
+#endif
+#ifdef HAVE_PCRE2
+#  define PCRE2_CODE_UNIT_WIDTH 8
+#  include <pcre2.h>
+#endif
+
+#include "matchers.h"
 #include "mem.h"
 #include "regex.h"
 
@@ -15,83 +25,501 @@
 
 static char *headline(char line, const char *buf, regmatch_t matches[],
 		      size_t nmatch, size_t off);
-static size_t charlen_utf8(const char *s);
+static size_t charlen_utf8(STRVIEW s);
+
+#define ENGINE_POSIX 0
+#define ENGINE_PCRE2 1
+
+struct rx {
+	matcher_fn match;         /* generated matcher, or NULL */
+	int anchored;             /* the matcher's pattern starts with ^ */
+	int engine;
+	int flags;
+	char prefix[32];          /* literal text every match starts with */
+	size_t prefix_len;
+	regex_t posix;
+#ifdef HAVE_PCRE2
+	pcre2_code *code;
+	pcre2_match_data *md;
+#endif
+};
+
+static int engine = -1;
+static int use_matchers = 1;  /* unset if ODT2TXT_REGEX forces an engine */
+#ifdef NO_THREADS
+static struct regex_stats the_stats;
+#else
+static pthread_key_t stats_key;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+
+static void stats_key_create(void)
+{
+	if (pthread_key_create(&stats_key, free)) {
+		fprintf(stderr, "Can't create regex statistics\n");
+		exit(EXIT_FAILURE);
+	}
+}
+#endif
+
+/* the counters of the calling thread */
+static struct regex_stats *stats_this(void)
+{
+#ifdef NO_THREADS
+	return &the_stats;
+#else
+	struct regex_stats *s;
+
+	(void)pthread_once(&stats_once, stats_key_create);
+	s = pthread_getspecific(stats_key);
+	if (!s) {
+		s = calloc(1, sizeof(struct regex_stats));
+		if (!s || pthread_setspecific(stats_key, s)) {
+			fprintf(stderr, "Can't create regex statistics\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	return s;
+#endif
+}
+
+static void select_engine(void)
+{
+	const char *name = getenv("ODT2TXT_REGEX");
+
+#ifdef HAVE_PCRE2
+	engine = ENGINE_PCRE2;
+#else
+	engine = ENGINE_POSIX;
+#endif
+	if (!name || !*name)
+		return;
+
+	use_matchers = 0;
+	if (!strcmp(name, "posix")) {
+		engine = ENGINE_POSIX;
+#ifdef HAVE_PCRE2
+	} else if (!strcmp(name, "pcre2")) {
+		engine = ENGINE_PCRE2;
+#endif
+	} else {
+		fprintf(stderr, "Unknown regex engine: %s\n", name);
+		exit(EXIT_FAILURE);
+	}
+}
+
+const char *rx_engine(void)
+{
+	if (engine == -1)
+		select_engine();
+
+#ifdef HAVE_PCRE2
+	if (engine == ENGINE_PCRE2) {
+		uint32_t jit = 0;
+
+		pcre2_config(PCRE2_CONFIG_JIT, &jit);
+		return jit ? "pcre2-jit" : "pcre2";
+	}
+#endif
+	return "posix";
+}
+
+matcher_fn matcher_find(const char *regex)
+{
+	const struct matcher *m;
+
+	for (m = matchers; m->regex; m++) {
+		if (!strcmp(m->regex, regex))
+			return m->match;
+	}
+	return NULL;
+}
+
+#ifdef HAVE_PCRE2
+static int compile_pcre2(RX *rx, const char *regex, char *err,
+			 size_t errlen)
+{
+	uint32_t opts = PCRE2_UTF;
+	int errcode;
+	PCRE2_SIZE erroff;
+
+#ifdef PCRE2_MATCH_INVALID_UTF
+	opts |= PCRE2_MATCH_INVALID_UTF;
+#endif
+	if (rx->flags & RX_NEWLINE)
+		opts |= PCRE2_MULTILINE;
+	rx->code = pcre2_compile((PCRE2_SPTR)regex, PCRE2_ZERO_TERMINATED,
+				 opts, &errcode, &erroff, NULL);
+	if (!rx->code) {
+		pcre2_get_error_message(errcode, (PCRE2_UCHAR *)err, errlen);
+		return -1;
+	}
+
+	/* without JIT support, pcre2_match interprets the pattern */
+	(void)pcre2_jit_compile(rx->code, PCRE2_JIT_COMPLETE);
+	rx->md = pcre2_match_data_create_from_pattern(rx->code, NULL);
+	return 0;
+}
+
+static int exec_pcre2(RX *rx, const char *s, size_t len, size_t start,
+		      regmatch_t m[], size_t nmatch)
+{
+	PCRE2_SIZE *ov;
+	uint32_t count;
+	size_t i;
+	int r;
+
+	r = pcre2_match(rx->code, (PCRE2_SPTR)s, len, start, 0, rx->md,
+			NULL);
+	if (r <= 0)
+		return 0;
+
+	ov = pcre2_get_ovector_pointer(rx->md);
+	count = pcre2_get_ovector_count(rx->md);
+	for (i = 0; i < nmatch; i++) {
+		if (i < count && ov[2 * i] != PCRE2_UNSET) {
+			m[i].rm_so = (regoff_t)ov[2 * i];
+			m[i].rm_eo = (regoff_t)ov[2 * i + 1];
+		} else {
+			m[i].rm_so = -1;
+			m[i].rm_eo = -1;
+		}
+	}
+	return 1;
+}
+#endif
+
+/*
+ * Finds the literal text which every match of regex starts with, so
+ * that the engine needs to run only where it occurs.  Patterns with
+ * alternatives or a leading ^ have none, and the scan stops at the
+ * first character which is not a plain literal or is optional.
+ */
+static void find_prefix(RX *rx, const char *regex)
+{
+	const char *p = regex;
+	const char *c;
+	size_t len;
+
+	if (*p == '^' || strchr(regex, '|'))
+		return;
+
+	while (*p) {
+		if (*p == '\\') {
+			/* \d, \w, \1 and the like are not literals */
+			if (!p[1] || isalnum((unsigned char)p[1]))
+				break;
+			c = p + 1;
+			len = 1;
+		} else if (strchr(".[]()*+?{}^$", *p)) {
+			break;
+		} else {
+			c = p;
+			len = 1;
+			if ((unsigned char)*p > 0x80)
+				len += utf8_length[(unsigned char)*p - 0x80];
+		}
+		if (strlen(c) < len)
+			break;
+		if (c[len] == '*' || c[len] == '?' || c[len] == '{')
+			break;
+		if (rx->prefix_len + len > sizeof(rx->prefix))
+			break;
+
+		memcpy(rx->prefix + rx->prefix_len, c, len);
+		rx->prefix_len += len;
+		if (c[len] == '+')
+			break;
+		p = c + len;
+	}
+}
+
+/*
+ * Returns the first occurrence of lit[0..n) in s[0..len), or NULL.
+ */
+static const char *find_literal(const char *s, size_t len,
+				const char *lit, size_t n)
+{
+	const char *end = s + len;
+	const char *p = s;
+
+	while ((size_t)(end - p) >= n) {
+		p = memchr(p, lit[0], (size_t)(end - p) - n + 1);
+		if (!p)
+			return NULL;
+		if (!memcmp(p + 1, lit + 1, n - 1))
+			return p;
+		p++;
+	}
+	return NULL;
+}
+
+RX *rx_compile(const char *regex, int flags, char *err, size_t errlen)
+{
+	RX *rx = ymalloc(sizeof(RX));
+	int r;
+
+	if (engine == -1)
+		select_engine();
+
+	memset(rx, 0, sizeof(RX));
+	rx->engine = engine;
+	if ((flags & RX_POSIX) && use_matchers)
+		rx->engine = ENGINE_POSIX;
+	rx->flags = flags;
+	/* the generated matchers know only the default syntax */
+	if (use_matchers && !flags)
+		rx->match = matcher_find(regex);
+	if (rx->match) {
+		rx->anchored = regex[0] == '^';
+		return rx;
+	}
+
+	find_prefix(rx, regex);
+
+#ifdef HAVE_PCRE2
+	if (rx->engine == ENGINE_PCRE2) {
+		if (compile_pcre2(rx, regex, err, errlen)) {
+			yfree(rx);
+			return NULL;
+		}
+		return rx;
+	}
+#endif
+
+	r = regcomp(&rx->posix, regex,
+		    REG_EXTENDED | ((flags & RX_NEWLINE) ? REG_NEWLINE : 0));
+	if (r) {
+		regerror(r, &rx->posix, err, errlen);
+		yfree(rx);
+		return NULL;
+	}
+	return rx;
+}
+
+/*
+ * Finds the first match in s[start..len).  The text before start is
+ * still seen by ^ and $, and the offsets in m are relative to s.
+ */
+static int exec_at(RX *rx, const char *s, size_t len, size_t start,
+		   regmatch_t m[], size_t nmatch)
+{
+	regmatch_t whole;
+	size_t i;
+	int eflags = 0;
+	int r;
+
+	if (rx->match) {
+		if (start && rx->anchored)
+			return 0;
+		if (!rx->match(s + start, len - start, m, nmatch))
+			return 0;
+		for (i = 0; i < nmatch; i++) {
+			if (m[i].rm_so != -1) {
+				m[i].rm_so += start;
+				m[i].rm_eo += start;
+			}
+		}
+		return 1;
+	}
+
+	/* no match can start before the first copy of the prefix */
+	if (rx->prefix_len) {
+		const char *p = find_literal(s + start, len - start,
+					     rx->prefix, rx->prefix_len);
+		if (!p)
+			return 0;
+		start = (size_t)(p - s);
+	}
+
+#ifdef HAVE_PCRE2
+	if (rx->engine == ENGINE_PCRE2)
+		return exec_pcre2(rx, s, len, start, m, nmatch);
+#endif
+
+	/* REG_STARTEND reads the range from m[0] */
+	if (!nmatch) {
+		m = &whole;
+		nmatch = 1;
+	}
+	if (start && !((rx->flags & RX_NEWLINE) && s[start - 1] == '\n'))
+		eflags |= REG_NOTBOL;
+#ifdef REG_STARTEND
+	m[0].rm_so = start;
+	m[0].rm_eo = len;
+	r = regexec(&rx->posix, s, nmatch, m, eflags | REG_STARTEND);
+#else
+	{
+		char *tmp = ymalloc(len - start + 1);
+
+		memcpy(tmp, s + start, len - start);
+		tmp[len - start] = '\0';
+		r = regexec(&rx->posix, tmp, nmatch, m, eflags);
+		yfree(tmp);
+		for (i = 0; r == 0 && i < nmatch; i++) {
+			if (m[i].rm_so != -1) {
+				m[i].rm_so += start;
+				m[i].rm_eo += start;
+			}
+		}
+	}
+#endif
+	return r == 0;
+}
+
+int rx_exec(RX *rx, const char *s, size_t len, regmatch_t m[],
+	    size_t nmatch)
+{
+	return exec_at(rx, s, len, 0, m, nmatch);
+}
+
+void rx_free(RX *rx)
+{
+	if (!rx->match) {
+#ifdef HAVE_PCRE2
+		if (rx->engine == ENGINE_PCRE2) {
+			pcre2_match_data_free(rx->md);
+			pcre2_code_free(rx->code);
+		} else
+#endif
+			regfree(&rx->posix);
+	}
+	yfree(rx);
+}
+
+void rx_iter_init(struct rx_iter *it, RX *rx, const char *s, size_t len)
+{
+	it->rx = rx;
+	it->s = s;
+	it->len = len;
+	it->next = 0;
+}
 
-static void print_regexp_err(int reg_errno, const regex_t *rx)
+int rx_iter_next(struct rx_iter *it, regmatch_t m[], size_t nmatch)
 {
-	char *buf = ymalloc(BUF_SZ);
+	regmatch_t whole;
 
-	regerror(reg_errno, rx, buf, BUF_SZ);
-	fprintf(stderr, "%s\n", buf);
+	if (it->next > it->len)
+		return 0;
+	if (!nmatch) {
+		m = &whole;
+		nmatch = 1;
+	}
+
+	if (!exec_at(it->rx, it->s, it->len, it->next, m, nmatch)) {
+		it->next = it->len + 1;
+		return 0;
+	}
 
-	yfree(buf);
+	it->next = (size_t)m[0].rm_eo;
+	if (m[0].rm_so == m[0].rm_eo) {
+		it->next++;
+		while (it->next < it->len &&
+		       ((unsigned char)it->s[it->next] & 0xc0) == 0x80)
+			it->next++;
+	}
+	return 1;
 }
 
 int regex_subst(STRBUF *buf,
 		const char *regex, int regopt,
 		const void *subst)
 {
-	int r;
-	const char *bufp;
-	size_t off = 0;
-	const int i = 0;
+	const char *s = strbuf_get(buf);
+	size_t len = strbuf_len(buf);
 	int match_count = 0;
 
-	regex_t rx;
+	RX *rx;
+	struct rx_iter it;
+	struct strbuf_rewrite rw;
+	char err[BUF_SZ];
 	const size_t nmatches = 10;
 	regmatch_t matches[10];
+	struct regex_stats *stats;
 
-	r = regcomp(&rx, regex, REG_EXTENDED);
-	if (r) {
-		print_regexp_err(r, &rx);
+	rx = rx_compile(regex, 0, err, sizeof(err));
+	if (!rx) {
+		fprintf(stderr, "%s\n", err);
 		exit(EXIT_FAILURE);
 	}
 
-	do {
-		if (off > strbuf_len(buf))
+	/* the text is only written over behind the matches, so the
+	   search never sees a replacement */
+	strbuf_rewrite_init(&rw, buf);
+	rx_iter_init(&it, rx, s, len);
+	while (rx_iter_next(&it, matches, nmatches)) {
+		strbuf_rewrite_keep(&rw, matches[0].rm_so);
+		strbuf_rewrite_skip(&rw, matches[0].rm_eo);
+
+		if (regopt & _REG_EXEC) {
+			char *r = (*(char *(*)
+				     (const char *buf, regmatch_t matches[],
+				      size_t nmatch, size_t off))subst)
+				(s, matches, nmatches, 0);
+			strbuf_rewrite_put(&rw, r, strlen(r));
+			yfree(r);
+		} else {
+			strbuf_rewrite_put(&rw, (const char *)subst,
+					   strlen((const char *)subst));
+		}
+
+		match_count++;
+		if (!(regopt & _REG_GLOBAL))
 			break;
+	}
+	rx_free(rx);
 
-		bufp = strbuf_get(buf) + off;
+	stats = stats_this();
+	stats->passes++;
+	stats->matches += match_count;
+	stats->scanned += it.next < len ? it.next : len;
 
-#ifdef REG_STARTEND
-		matches[0].rm_so = 0;
-		matches[0].rm_eo = strbuf_len(buf) - off;
+	if (match_count)
+		strbuf_rewrite_finish(&rw);
+	return match_count;
+}
 
-		if (0 != regexec(&rx, bufp, nmatches, matches, REG_STARTEND))
-#else
-		if (0 != regexec(&rx, bufp, nmatches, matches, 0))
-#endif
+size_t regex_grep(RX *rx, const char *buf, size_t len,
+		  regex_grep_fn fn, void *data)
+{
+	const char *end = buf + len;
+	const char *line, *eol;
+	size_t from = 0;
+	size_t count = 0;
+	struct rx_iter it;
+	regmatch_t m;
+	struct regex_stats *stats;
+
+	rx_iter_init(&it, rx, buf, len);
+	while (rx_iter_next(&it, &m, 1)) {
+		/* nor does the empty line after a final newline */
+		if ((size_t)m.rm_so == len && (!len || buf[len - 1] == '\n'))
 			break;
 
-		if (matches[i].rm_so != -1) {
-			char *s;
-			int subst_len;
-
-			if (regopt & _REG_EXEC) {
-				s = (*(char *(*)
-				       (const char *buf, regmatch_t matches[],
-					size_t nmatch, size_t off))subst)
-					(strbuf_get(buf), matches, nmatches, off);
-			} else
-				s = (char*)subst;
-
-			subst_len = strbuf_subst(buf,
-						 matches[i].rm_so + off,
-						 matches[i].rm_eo + off,
-						 s);
-			match_count++;
-
-			if (regopt & _REG_EXEC)
-				yfree(s);
-
-			off += matches[i].rm_so;
-			if (subst_len >= 0)
-				off += subst_len + 1;
-		}
-	} while (regopt & _REG_GLOBAL);
+		line = buf + m.rm_so;
+		while (line > buf + from && line[-1] != '\n')
+			line--;
+		eol = memchr(buf + m.rm_so, '\n', len - m.rm_so);
+		if (!eol)
+			eol = end;
 
-	regfree(&rx);
-	return match_count;
+		from = (size_t)(eol - buf) + 1;
+		it.next = from;
+
+		/* a match across lines counts only if the line matches */
+		if (buf + m.rm_eo > eol &&
+		    !rx_exec(rx, line, (size_t)(eol - line), NULL, 0))
+			continue;
+
+		count++;
+		if (fn(line, (size_t)(eol - line), data))
+			break;
+	}
+
+	stats = stats_this();
+	stats->passes++;
+	stats->matches += count;
+	stats->scanned += it.next < len ? it.next : len;
+	return count;
 }
 
 int regex_rm(STRBUF *buf,
@@ -100,21 +528,31 @@ int regex_rm(STRBUF *buf,
 	return regex_subst(buf, regex, regopt, "");
 }
 
+void regex_stats(struct regex_stats *stats)
+{
+	*stats = *stats_this();
+}
+
 char *underline(char linechar, const char *str)
+{
+	return underline_view(linechar, strview_n(str, strlen(str)));
+}
+
+char *underline_view(char linechar, STRVIEW str)
 {
 	size_t i;
 	char *tmp;
 	STRBUF *line;
 	size_t charlen = charlen_utf8(str);
 
-	if (str[0] == '\0') {
+	if (!str.len) {
 		tmp = ymalloc(1);
 		tmp[0] = '\0';
 		return tmp;
 	}
 
 	line = strbuf_new();
-	strbuf_append(line, str);
+	strbuf_append_view(line, str);
 	strbuf_append(line, "\n");
 
 	tmp = ymalloc(charlen);
@@ -132,20 +570,9 @@ static char *headline(char line, const char *buf, regmatch_t matches[],
 		      size_t nmatch, size_t off)
 {
 	const int i = 1;
-	char *result;
-	size_t len;
-	char *match;
-
-	len = matches[i].rm_eo - matches[i].rm_so;
-	match = ymalloc(len + 1);
-
-	memcpy(match, buf + matches[i].rm_so + off, len);
-	match[len] = '\0' ;
-
-	result = underline(line, match);
 
-	yfree(match);
-	return result;
+	return underline_view(line, strview_n(buf + matches[i].rm_so + off,
+				matches[i].rm_eo - matches[i].rm_so));
 }
 
 char *h1(const char *buf, regmatch_t matches[], size_t nmatch, size_t off)
@@ -179,11 +606,13 @@ char *image(const char *buf, regmatch_t matches[], size_t nmatch, size_t off)
 	return match;
 }
 
-static size_t charlen_utf8(const char *s)
+static size_t charlen_utf8(STRVIEW s)
 {
 	size_t count = 0;
-	unsigned char *t = (unsigned char*) s;
-	while (*t != '\0') {
+	const unsigned char *t = (const unsigned char *)s.data;
+	const unsigned char *end = t + s.len;
+
+	while (t < end) {
 		if (*t > 0x80)
 			t += utf8_length[*t - 0x80];
 		count++;
@@ -192,32 +621,134 @@ static size_t charlen_utf8(const char *s)
 	return count;
 }
 
+struct wrapper {
+	STRBUF *out;
+	size_t chars;        /* characters written so far */
+	int newlines;        /* newlines written since the last text */
+	wrap_para_fn para;
+	void *data;
+};
+
+static void wrap_newline(struct wrapper *w);
+
+/*
+ * Appends a piece of text to the output.  If trim is set, the text
+ * is followed by a newline and its trailing spaces are dropped.
+ */
+static void wrap_text(struct wrapper *w, const char *s, size_t n, int trim)
+{
+	size_t i;
+
+	if (trim)
+		while (n && s[n - 1] == ' ')
+			n--;
+	/* a line broken in its trailing spaces leaves the newline
+	   after them at the start of the next piece */
+	while (n && *s == '\n') {
+		wrap_newline(w);
+		s++;
+		n--;
+	}
+	if (!n)
+		return;
+
+	if (w->para) {
+		if (w->newlines > 1)
+			w->para(strbuf_len(w->out), w->chars, w->data);
+		for (i = 0; i < n; i++)
+			if (((unsigned char)s[i] & 0xc0) != 0x80)
+				w->chars++;
+	}
+
+	strbuf_append_n(w->out, s, n);
+	w->newlines = 0;
+}
+
+static void wrap_newline(struct wrapper *w)
+{
+	strbuf_append_n(w->out, "\n", 1);
+	w->chars++;
+	w->newlines++;
+}
+
 STRBUF *wrap(STRBUF *buf, int width)
 {
-	const char *lf = "\n";
-	const size_t lflen = strlen(lf);
+	return wrap_para(buf, width, NULL, NULL);
+}
+
+/*
+ * Returns 1 if a line of s[0..len) which is followed by a newline
+ * ends with a space.
+ */
+static int has_trailing_space(const char *s, size_t len)
+{
+	const char *end = s + len;
+	const char *p = s;
+
+	while ((p = memchr(p, '\n', (size_t)(end - p)))) {
+		if (p > s && p[-1] == ' ')
+			return 1;
+		p++;
+	}
+	return 0;
+}
+
+STRVIEW wrap_view(STRBUF *buf, int width, STRBUF **out)
+{
+	if (width == -1 &&
+	    !has_trailing_space(strbuf_get(buf), strbuf_len(buf))) {
+		*out = NULL;
+		return strbuf_view(buf);
+	}
+
+	*out = wrap(buf, width);
+	return strbuf_view(*out);
+}
+
+STRBUF *wrap_para(STRBUF *buf, int width, wrap_para_fn para, void *data)
+{
 	const char *bufp;
 	const char *last;
 	const char *lastspace = 0;
+	const char *end;
 	size_t linelen = 0;
-	STRBUF *out = strbuf_new();
+	struct wrapper w;
+
+	w.out = strbuf_new();
+	w.chars = 0;
+	w.newlines = 2;
+	w.para = para;
+	w.data = data;
 
 	bufp = strbuf_get(buf);
+	end = bufp + strbuf_len(buf);
 	last = bufp;
 
 	if (width == -1) {
-		strbuf_append_n(out, strbuf_get(buf), strbuf_len(buf));
-		return out;
+		while (bufp < end) {
+			last = memchr(bufp, '\n', (size_t)(end - bufp));
+			if (!last) {
+				wrap_text(&w, bufp, (size_t)(end - bufp), 0);
+				break;
+			}
+			wrap_text(&w, bufp, (size_t)(last - bufp), 1);
+			wrap_newline(&w);
+			bufp = last + 1;
+		}
+
+		if (para)
+			para(strbuf_len(w.out), w.chars, data);
+		return w.out;
 	}
 
-	strbuf_append_n(out, lf, lflen);
-	while(bufp - strbuf_get(buf) < (ptrdiff_t)strbuf_len(buf)) {
+	wrap_newline(&w);
+	while(bufp < end) {
 		if (*bufp == ' ')
 			lastspace = bufp;
 		else if (*bufp == '\n') {
-			strbuf_append_n(out, last, (size_t)(bufp - last));
+			wrap_text(&w, last, (size_t)(bufp - last), 1);
 			do {
-				strbuf_append_n(out, lf, lflen);
+				wrap_newline(&w);
 			} while (*++bufp == '\n');
 			lastspace = NULL;
 
@@ -229,8 +760,8 @@ STRBUF *wrap(STRBUF *buf, int width)
 		}
 
 		if (NULL != lastspace && (int)linelen > width) {
-			strbuf_append_n(out, last, (size_t)(lastspace - last));
-			strbuf_append_n(out, lf, lflen);
+			wrap_text(&w, last, (size_t)(lastspace - last), 1);
+			wrap_newline(&w);
 			last = lastspace;
 			lastspace = NULL;
 			linelen = (size_t)(bufp - last);
@@ -247,7 +778,9 @@ STRBUF *wrap(STRBUF *buf, int width)
 		if ((unsigned char)*bufp > 0x80)
 			bufp += utf8_length[(unsigned char)*bufp - 0x80];
 	}
-	strbuf_append_n(out, "\n", 1);
-	return out;
-}
+	wrap_newline(&w);
 
+	if (para)
+		para(strbuf_len(w.out), w.chars, data);
+	return w.out;
+}
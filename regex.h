@@ -19,6 +19,65 @@
 
 #include "strbuf.h"
 
+/*
+ * A compiled regular expression.  Patterns which have a generated
+ * matcher use it, all others are compiled by the regex engine chosen
+ * at build time: POSIX regcomp by default, or PCRE2 with its JIT
+ * compiler if odt2txt was built with PCRE2=1.
+ *
+ * The environment variable ODT2TXT_REGEX=posix or =pcre2 forces an
+ * engine for all patterns, including the fixed ones.  It is meant
+ * for benchmarks and tests.
+ */
+typedef struct rx RX;
+
+#define RX_NEWLINE    1  /* ^ and $ match at newlines, like REG_NEWLINE */
+#define RX_POSIX      2  /* POSIX syntax in any build, unless
+			    ODT2TXT_REGEX forces an engine */
+
+/*
+ * Compiles the extended regular expression regex.  On error, returns
+ * NULL and stores a message in err.
+ */
+RX *rx_compile(const char *regex, int flags, char *err, size_t errlen);
+
+/*
+ * Finds the first match of rx in s[0..len), like regexec with
+ * REG_STARTEND.  Returns 1 on a match and fills in nmatch entries of
+ * m, 0 otherwise.
+ */
+int rx_exec(RX *rx, const char *s, size_t len, regmatch_t m[],
+	    size_t nmatch);
+
+void rx_free(RX *rx);
+
+/*
+ * Iterates over the matches of rx in s[0..len) in one forward scan.
+ * Matches do not overlap, and after an empty match the scan moves on
+ * by one character.  next is where the following search starts; the
+ * caller may move it forward to skip a part of s.
+ */
+struct rx_iter {
+	RX *rx;
+	const char *s;
+	size_t len;
+	size_t next;
+};
+
+void rx_iter_init(struct rx_iter *it, RX *rx, const char *s, size_t len);
+
+/*
+ * Finds the next match.  Returns 1 and fills in nmatch entries of m,
+ * with offsets relative to s, or 0 if there are no more matches.
+ */
+int rx_iter_next(struct rx_iter *it, regmatch_t m[], size_t nmatch);
+
+/*
+ * Returns the name of the engine which compiles patterns that have
+ * no generated matcher.
+ */
+const char *rx_engine(void);
+
 #define _REG_DEFAULT  0  /* Stop after first match, to be removed */
 #define _REG_GLOBAL   1  /* Find all matches of regexp */
 #define _REG_EXEC     2  /* subst is a function pointer */
@@ -32,18 +91,51 @@ int regex_rm(STRBUF *buf,
 	     const char *regex, int regopt);
 
 /*
- * Replaces match(es) of regex from *buf with subst.
+ * Replaces match(es) of regex from *buf with subst.  The text is
+ * scanned once from left to right, so a replacement is never
+ * matched again.
+ *
+ * Returns the number of matches that were replaced.
  */
 int regex_subst(STRBUF *buf,
 		const char *regex, int regopt,
 		const void *subst);
 
+/*
+ * Called by regex_grep for every matching line.  A nonzero return
+ * value stops the search.
+ */
+typedef int (*regex_grep_fn)(const char *line, size_t len, void *data);
+
+/*
+ * Calls fn for every line in buf[0..len) which matches the compiled
+ * regex rx.  rx should be compiled with RX_NEWLINE.
+ *
+ * Returns the number of matching lines.
+ */
+size_t regex_grep(RX *rx, const char *buf, size_t len,
+		  regex_grep_fn fn, void *data);
+
+/*
+ * Counts of the passes of regex_subst and regex_grep over a text,
+ * the matches they found and the bytes they searched.  They are
+ * always kept, for each thread since it started.
+ */
+struct regex_stats {
+	size_t passes;
+	size_t matches;
+	size_t scanned;
+};
+
+void regex_stats(struct regex_stats *stats);
+
 /*
  * Returns a pointer to a new string with two lines. The first line
- * contains str, the second line contains strlen(str) copies of
- * linechar.
+ * contains str, the second line contains one copy of linechar for
+ * every character of str.
  */
 char *underline(char linechar, const char *str);
+char *underline_view(char linechar, STRVIEW str);
 
 /*
  * Wrappers around underline, to be used as argument to regex_subst
@@ -62,10 +154,32 @@ char *image(const char *buf, regmatch_t matches[], size_t nmatch, size_t off);
 
 /*
  * Copies the contents of buf to a new string buffer, wrapped to a
- * maximal line width of width characters.
+ * maximal line width of width characters.  Trailing spaces are
+ * removed from all lines.
  */
 STRBUF *wrap(STRBUF *buf, int width);
 
+/*
+ * Like wrap, but avoids the copy if the wrapped text would be the
+ * same as buf, which happens with a width of -1 if no line ends with
+ * spaces.  Then *out is NULL and the result is a view of buf.
+ * Otherwise *out is the wrapped text, which the caller must free,
+ * and the result is a view of it.
+ */
+STRVIEW wrap_view(STRBUF *buf, int width, STRBUF **out);
+
+/*
+ * Called by wrap_para at the start of every paragraph with its byte
+ * and character offset in the output, and once more at the end of
+ * the output.
+ */
+typedef void (*wrap_para_fn)(size_t offset, size_t chars, void *data);
+
+/*
+ * Like wrap, but reports the start of every paragraph to para.
+ */
+STRBUF *wrap_para(STRBUF *buf, int width, wrap_para_fn para, void *data);
+
 /*
  * number of characters that follow in the byte sequence
  */
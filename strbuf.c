@@ -8,12 +8,73 @@
  * version 2 as published by the Free Software Foundation
  */
 
+#ifndef WIN32
+#  define HAVE_MMAP
+#  define _GNU_SOURCE  /* for mremap */
+#endif
+
+#ifdef HAVE_MMAP
+#  include <sys/mman.h>
+#  include <unistd.h>
+#  if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#    define MAP_ANONYMOUS MAP_ANON
+#  endif
+#  ifndef MAP_ANONYMOUS
+#    undef HAVE_MMAP
+#  endif
+#endif
+#ifndef NO_THREADS
+#  include <pthread.h>
+#endif
+
 #include "strbuf.h"
+#include "trace.h"
 
 static const size_t strbuf_start_sz = 128;
-static const size_t strbuf_grow_sz = 128;
 
-static void strbuf_grow(STRBUF *buf); /* enlarge a buffer by strbuf_grow_sz */
+static void strbuf_grow(STRBUF *buf, size_t size); /* make buf_sz >= size */
+static void count_resize(const char *old, const char *new, size_t n);
+
+/*
+ * Backing stores of 4k and more have sizes which are powers of two.
+ * When they are freed, they go to a free list for their size in a
+ * pool of the thread instead of back to the system.
+ */
+#define POOL_MIN_SHIFT 12
+#define POOL_CLASSES   20      /* 4k to 2G */
+#define POOL_SLACK     2       /* a buffer may get a block 4 times larger */
+
+struct bufpool {
+	char *free[POOL_CLASSES];  /* linked through their first bytes */
+	size_t live;               /* bytes in pooled sizes handed out */
+	size_t high;               /* most bytes live since the last trim */
+	size_t cached;             /* bytes on the free lists */
+	struct strbuf_stats stats; /* memory traffic of the thread */
+};
+
+/*
+ * ODT2TXT_BUFFERS selects how blocks of MAP_MIN bytes and more are
+ * allocated: with malloc, or mapped with mmap and hints for the
+ * kernel.  Mapped blocks give their pages back with MADV_DONTNEED
+ * when they go to the pool.  Without HAVE_MMAP, there is only malloc.
+ */
+#define MAP_MIN ((size_t)8 << 20)
+#define HUGE_PAGE ((size_t)2 << 20)
+
+enum map_mode {
+	MAP_NONE,     /* "malloc" */
+	MAP_PLAIN,    /* "mmap", sequential access */
+	MAP_HUGE      /* "huge", also transparent huge pages */
+};
+
+static int map_mode = -1;
+
+#ifdef NO_THREADS
+static struct bufpool the_pool;
+#else
+static pthread_key_t pool_key;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+#endif
 
 #ifdef STRBUF_CHECK
 static void die(const char *format, ...) {
@@ -44,6 +105,323 @@ static void strbuf_check(STRBUF *buf)
 #define strbuf_check(a)
 #endif
 
+static size_t class_size(int c)
+{
+	return (size_t)1 << (c + POOL_MIN_SHIFT);
+}
+
+/* the class of a backing store of size bytes, or -1 if not pooled */
+static int size_class(size_t size)
+{
+	int c;
+
+	if (size & (size - 1))
+		return -1;
+	for (c = 0; c < POOL_CLASSES; c++)
+		if (class_size(c) == size)
+			return c;
+	return -1;
+}
+
+/* the smallest class which holds size bytes, or -1 */
+static int fit_class(size_t size)
+{
+	int c;
+
+	if (size < class_size(0))
+		return -1;
+	for (c = 0; c < POOL_CLASSES; c++)
+		if (class_size(c) >= size)
+			return c;
+	return -1;
+}
+
+static void select_map_mode(void)
+{
+	const char *name = getenv("ODT2TXT_BUFFERS");
+
+	if (!name || !*name || !strcmp(name, "malloc")) {
+		map_mode = MAP_NONE;
+#ifdef HAVE_MMAP
+	} else if (!strcmp(name, "mmap")) {
+		map_mode = MAP_PLAIN;
+	} else if (!strcmp(name, "huge")) {
+		map_mode = MAP_HUGE;
+#endif
+	} else {
+		fprintf(stderr, "Unknown buffer allocation: %s\n", name);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* whether a block of size bytes is mapped rather than malloc'd */
+static int is_mapped(size_t size)
+{
+	if (map_mode == -1)
+		select_map_mode();
+	return map_mode != MAP_NONE && size >= MAP_MIN &&
+		size_class(size) != -1;
+}
+
+/*
+ * The size of a malloc'd backing store for n bytes.  It must not be
+ * the size of a pooled block, which would be taken for one.
+ */
+static size_t exact_size(size_t n)
+{
+	return size_class(n) == -1 ? n : n + 1;
+}
+
+#ifdef HAVE_MMAP
+static char *map_block(size_t size)
+{
+	size_t extra = map_mode == MAP_HUGE ? HUGE_PAGE : 0;
+	char *data, *start;
+
+	data = mmap(NULL, size + extra, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "Can't map %lu bytes\n", (unsigned long)size);
+		exit(EXIT_FAILURE);
+	}
+
+	start = data;
+	if (extra) {
+		/* huge pages need an aligned start */
+		start = (char *)(((size_t)data + HUGE_PAGE - 1)
+				 & ~(HUGE_PAGE - 1));
+		if (start > data)
+			munmap(data, (size_t)(start - data));
+		if (start + size < data + size + extra)
+			munmap(start + size,
+			       (size_t)(data + size + extra - (start + size)));
+#ifdef MADV_HUGEPAGE
+		(void)madvise(start, size, MADV_HUGEPAGE);
+#endif
+	}
+	(void)madvise(start, size, MADV_SEQUENTIAL);
+	return start;
+}
+#endif
+
+static char *block_new(size_t size)
+{
+#ifdef HAVE_MMAP
+	if (is_mapped(size))
+		return map_block(size);
+#endif
+	return ymalloc(size);
+}
+
+static void block_destroy(char *data, size_t size)
+{
+#ifdef HAVE_MMAP
+	if (is_mapped(size)) {
+		munmap(data, size);
+		return;
+	}
+#else
+	(void)size;
+#endif
+	yfree(data);
+}
+
+/*
+ * Moves the text data[0..len] from a block of size bytes to one of
+ * new_size bytes, where either may be mapped.
+ */
+static char *block_realloc(char *data, size_t size, size_t len,
+			   size_t new_size)
+{
+	size_t n = len + 1 < new_size ? len + 1 : new_size;
+	char *block;
+
+	if (!is_mapped(size) && !is_mapped(new_size)) {
+		block = yrealloc(data, new_size);
+		count_resize(data, block, n);
+		return block;
+	}
+#ifdef MREMAP_MAYMOVE
+	/* a moved mapping would lose its huge page alignment */
+	if (is_mapped(size) && is_mapped(new_size) && map_mode != MAP_HUGE) {
+		block = mremap(data, size, new_size, MREMAP_MAYMOVE);
+		if (block != MAP_FAILED) {
+			/* the pages move, the bytes are not copied */
+			count_resize(data, data, n);
+			return block;
+		}
+	}
+#endif
+
+	block = block_new(new_size);
+	memcpy(block, data, n);
+	count_resize(data, block, n);
+	block_destroy(data, size);
+	return block;
+}
+
+static void pool_empty(struct bufpool *p)
+{
+	char *data;
+	int c;
+
+	for (c = 0; c < POOL_CLASSES; c++) {
+		while ((data = p->free[c])) {
+			memcpy(&p->free[c], data, sizeof(char *));
+			block_destroy(data, class_size(c));
+		}
+	}
+	p->cached = 0;
+}
+
+#ifndef NO_THREADS
+static void pool_destroy(void *p)
+{
+	pool_empty(p);
+	free(p);
+}
+
+static void pool_key_create(void)
+{
+	if (pthread_key_create(&pool_key, pool_destroy)) {
+		fprintf(stderr, "Can't create buffer pool\n");
+		exit(EXIT_FAILURE);
+	}
+}
+#endif
+
+/* the pool of the calling thread, created if create is set */
+static struct bufpool *pool_this(int create)
+{
+#ifdef NO_THREADS
+	(void)create;
+	return &the_pool;
+#else
+	struct bufpool *p;
+
+	(void)pthread_once(&pool_once, pool_key_create);
+	p = pthread_getspecific(pool_key);
+	if (!p && create) {
+		p = calloc(1, sizeof(struct bufpool));
+		if (!p || pthread_setspecific(pool_key, p)) {
+			fprintf(stderr, "Can't create buffer pool\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	return p;
+#endif
+}
+
+static void pool_enter(struct bufpool *p, size_t size)
+{
+	p->live += size;
+	if (p->live > p->high)
+		p->high = p->live;
+}
+
+static void pool_leave(struct bufpool *p, size_t size)
+{
+	/* a block can be freed by another thread than its owner */
+	p->live = p->live > size ? p->live - size : 0;
+}
+
+static void count_move(size_t n)
+{
+	pool_this(1)->stats.moved += n;
+}
+
+static void count_copy(size_t n)
+{
+	pool_this(1)->stats.copied += n;
+}
+
+/* a backing store of n bytes in use went from old to new */
+static void count_resize(const char *old, const char *new, size_t n)
+{
+	struct bufpool *p = pool_this(1);
+
+	p->stats.reallocs++;
+	if (new != old)
+		p->stats.realloc_copied += n;
+}
+
+/*
+ * Hands out a block of class *c, or a cached one of up to slack
+ * classes more, and sets *c to its class.
+ */
+static char *block_alloc(int *c, int slack)
+{
+	struct bufpool *p = pool_this(1);
+	char *data = NULL;
+	int i;
+
+	for (i = *c; i < POOL_CLASSES && i <= *c + slack; i++) {
+		if ((data = p->free[i])) {
+			memcpy(&p->free[i], data, sizeof(char *));
+			p->cached -= class_size(i);
+			*c = i;
+			break;
+		}
+	}
+	if (!data)
+		data = block_new(class_size(*c));
+	pool_enter(p, class_size(*c));
+	return data;
+}
+
+static void block_free(char *data, size_t size)
+{
+	int c = size_class(size);
+	struct bufpool *p;
+
+	if (c == -1) {
+		yfree(data);
+		return;
+	}
+
+	p = pool_this(1);
+	memcpy(data, &p->free[c], sizeof(char *));
+	p->free[c] = data;
+#ifdef HAVE_MMAP
+	if (is_mapped(size)) {
+		/* keep the page with the link */
+		long page = sysconf(_SC_PAGESIZE);
+
+		(void)madvise(data + page, size - (size_t)page, MADV_DONTNEED);
+	}
+#endif
+	p->cached += size;
+	pool_leave(p, size);
+}
+
+/*
+ * Moves the text data[0..len] from a backing store of size bytes to
+ * one of class *c or a little larger, and sets *c to its class.  A
+ * recycled block is preferred, otherwise realloc may be able to grow
+ * the block where it is.
+ */
+static char *block_resize(char *data, size_t size, size_t len, int *c)
+{
+	struct bufpool *p = pool_this(1);
+	char *block;
+	int i;
+
+	for (i = *c; i < POOL_CLASSES && i <= *c + POOL_SLACK; i++) {
+		if (p->free[i]) {
+			block = block_alloc(c, POOL_SLACK);
+			memcpy(block, data, len + 1 < size ? len + 1 : size);
+			count_resize(data, block, len + 1 < size ? len + 1 : size);
+			block_free(data, size);
+			return block;
+		}
+	}
+
+	if (size_class(size) != -1)
+		pool_leave(p, size);
+	pool_enter(p, class_size(*c));
+	return block_realloc(data, size, len, class_size(*c));
+}
+
 STRBUF *strbuf_new(void)
 {
 	STRBUF *buf = ymalloc(sizeof(STRBUF));
@@ -64,16 +442,41 @@ void strbuf_free(STRBUF *buf)
 {
 	strbuf_check(buf);
 
-	yfree(buf->data);
+	block_free(buf->data, buf->buf_sz);
 	yfree(buf);
 }
 
 void strbuf_shrink(STRBUF *buf)
 {
+	int c = fit_class(buf->len + 1);
+	char *data;
+
 	strbuf_check(buf);
 
-	buf->buf_sz = buf->len + 1;
-	buf->data = yrealloc(buf->data, buf->buf_sz);
+	if (size_class(buf->buf_sz) == -1 || c == -1) {
+		size_t size = exact_size(buf->len + 1);
+
+		if (size_class(buf->buf_sz) != -1)
+			pool_leave(pool_this(1), buf->buf_sz);
+		buf->data = block_realloc(buf->data, buf->buf_sz, buf->len,
+					  size);
+		buf->buf_sz = size;
+	} else if (class_size(c) < buf->buf_sz) {
+		/* stay in the pool, which makes some slack acceptable */
+		if (pool_this(1)->free[c]) {
+			data = block_alloc(&c, 0);
+			memcpy(data, buf->data, buf->len + 1);
+			count_resize(buf->data, data, buf->len + 1);
+			block_free(buf->data, buf->buf_sz);
+			buf->data = data;
+		} else {
+			pool_leave(pool_this(1), buf->buf_sz);
+			pool_enter(pool_this(1), class_size(c));
+			buf->data = block_realloc(buf->data, buf->buf_sz,
+						  buf->len, class_size(c));
+		}
+		buf->buf_sz = class_size(c);
+	}
 
 	strbuf_check(buf);
 }
@@ -85,10 +488,11 @@ size_t strbuf_append_n(STRBUF *buf, const char *str, size_t n)
 	if (n == 0)
 		return buf->len;
 
-	while (buf->len + n + 1 > buf->buf_sz)
-		strbuf_grow(buf);
+	if (buf->len + n + 1 > buf->buf_sz)
+		strbuf_grow(buf, buf->len + n + 1);
 
 	memcpy(buf->data + buf->len, str, n);
+	count_copy(n);
 	buf->len += n;
 	*(buf->data + buf->len) = 0;
 
@@ -113,6 +517,26 @@ size_t strbuf_len(STRBUF *buf)
 	return buf->len;
 }
 
+STRVIEW strbuf_view(STRBUF *buf)
+{
+	strbuf_check(buf);
+	return strview_n(buf->data, buf->len);
+}
+
+STRVIEW strview_n(const char *str, size_t n)
+{
+	STRVIEW view;
+
+	view.data = str;
+	view.len = n;
+	return view;
+}
+
+size_t strbuf_append_view(STRBUF *buf, STRVIEW view)
+{
+	return strbuf_append_n(buf, view.data, view.len);
+}
+
 int strbuf_subst(STRBUF *buf,
 		 size_t start, size_t stop,
 		 const char *subst)
@@ -137,18 +561,21 @@ int strbuf_subst(STRBUF *buf,
 		memcpy(buf->data + start, subst, subst_len);
 		memmove(buf->data + start + subst_len, buf->data + stop,
 			buf->len - stop + 1);
+		count_move(buf->len - stop + 1);
 
 	} else if (0 == diff) {
 		memcpy(buf->data + start, subst, subst_len);
 
 	} else { /* 0 < diff */
-		while (buf->len + diff + 1 > buf->buf_sz)
-			strbuf_grow(buf);
+		if (buf->len + diff + 1 > buf->buf_sz)
+			strbuf_grow(buf, buf->len + diff + 1);
 
 		memmove(buf->data + start + subst_len, buf->data + stop,
 			buf->len - stop + 1);
+		count_move(buf->len - stop + 1);
 		memcpy(buf->data + start, subst, subst_len);
 	}
+	count_copy(subst_len);
 
 	buf->len += diff;
 
@@ -157,12 +584,19 @@ int strbuf_subst(STRBUF *buf,
 }
 
 size_t strbuf_append_inflate(STRBUF *buf, FILE *in)
+{
+	return strbuf_append_inflate_cb(buf, in, NULL, NULL);
+}
+
+size_t strbuf_append_inflate_cb(STRBUF *buf, FILE *in,
+				strbuf_inflate_fn fn, void *data)
 {
 	size_t len;
 	z_stream strm;
 	Bytef readbuf[1024];
 	int z_ret;
 	int nullok;
+	int stopped = 0;
 
 	strbuf_check(buf);
 
@@ -200,13 +634,16 @@ size_t strbuf_append_inflate(STRBUF *buf, FILE *in)
 
 		strm.next_in = readbuf;
 		do {
-			size_t bytes_inflated;
+			size_t bytes_inflated, room;
 
-			while (buf->buf_sz < buf->len + sizeof(readbuf) * 2)
-				strbuf_grow(buf);
+			if (buf->buf_sz < buf->len + sizeof(readbuf) * 2)
+				strbuf_grow(buf, buf->len + sizeof(readbuf) * 2);
 
+			/* one byte is kept for the terminator, which fn
+			   may rely on */
+			room = buf->buf_sz - buf->len - 1;
 			strm.next_out  = (Bytef*)(buf->data + buf->len);
-			strm.avail_out = (uInt)(buf->buf_sz - buf->len);
+			strm.avail_out = (uInt)room;
 
 			z_ret = inflate(&strm, Z_SYNC_FLUSH);
 			switch (z_ret) {
@@ -218,16 +655,23 @@ size_t strbuf_append_inflate(STRBUF *buf, FILE *in)
 				exit(EXIT_FAILURE);
 			}
 
-			bytes_inflated  = (buf->buf_sz - buf->len) - strm.avail_out;
+			bytes_inflated  = room - strm.avail_out;
 			buf->len       += bytes_inflated;
+			buf->data[buf->len] = '\0';
+
+			if (fn && fn(buf, data)) {
+				stopped = 1;
+				goto stop;
+			}
 
 		} while (strm.avail_out == 0);
 
 	} while (z_ret != Z_STREAM_END);
+stop:
 
 	/* terminate buffer */
 	if (buf->len + 1 > buf->buf_sz)
-		strbuf_grow(buf);
+		strbuf_grow(buf, buf->len + 1);
 	*(buf->data + buf->len) = '\0';
 
 	/* restore NULLOK option */
@@ -239,7 +683,7 @@ size_t strbuf_append_inflate(STRBUF *buf, FILE *in)
 	len = (size_t)strm.total_out;
 	(void)inflateEnd(&strm);
 
-	if (z_ret != Z_STREAM_END) {
+	if (z_ret != Z_STREAM_END && !stopped) {
 		fprintf(stderr, "ERR\n");
 		exit(EXIT_FAILURE);
 	}
@@ -247,11 +691,36 @@ size_t strbuf_append_inflate(STRBUF *buf, FILE *in)
 	return len;
 }
 
-static void strbuf_grow(STRBUF *buf)
+static void strbuf_grow(STRBUF *buf, size_t size)
 {
-	buf->buf_sz += strbuf_grow_sz;
-	buf->data = yrealloc(buf->data, buf->buf_sz);
+	size_t old = buf->buf_sz;
+	size_t want = buf->buf_sz * 2;
+	int c;
+
+	if (want < size)
+		want = size;
+	c = fit_class(want);
+
+	if (c == -1 && want >= class_size(0)) {
+		/* too large for the pool */
+		size = exact_size(size);
+		if (size_class(buf->buf_sz) != -1)
+			pool_leave(pool_this(1), buf->buf_sz);
+		buf->data = block_realloc(buf->data, buf->buf_sz, buf->len,
+					  size);
+		buf->buf_sz = size;
+	} else if (c == -1) {
+		char *data = yrealloc(buf->data, want);
+
+		count_resize(buf->data, data, buf->len + 1);
+		buf->buf_sz = want;
+		buf->data = data;
+	} else {
+		buf->data = block_resize(buf->data, buf->buf_sz, buf->len, &c);
+		buf->buf_sz = class_size(c);
+	}
 
+	TRACE3(strbuf__grow, old, buf->buf_sz, buf->len);
 	strbuf_check(buf);
 }
 
@@ -264,7 +733,7 @@ STRBUF *strbuf_slurp_n(char *str, size_t len)
 {
 	STRBUF *buf = ymalloc(sizeof(STRBUF));
 	buf->len = len;
-	buf->buf_sz = len + 1;
+	buf->buf_sz = exact_size(len + 1);
 	buf->data = yrealloc(str, buf->buf_sz);
 	*(buf->data + len) = '\0';
 
@@ -279,13 +748,33 @@ char *strbuf_spit(STRBUF *buf)
 
 	strbuf_check(buf);
 
-	strbuf_shrink(buf);
-	data = buf->data;
+	if (size_class(buf->buf_sz) != -1) {
+		/* the caller frees it, so it must leave the pool */
+		data = ymalloc(buf->len + 1);
+		memcpy(data, buf->data, buf->len + 1);
+		count_copy(buf->len + 1);
+		block_free(buf->data, buf->buf_sz);
+	} else {
+		strbuf_shrink(buf);
+		data = buf->data;
+	}
 	yfree(buf);
 
 	return data;
 }
 
+void strbuf_swap(STRBUF *a, STRBUF *b)
+{
+	STRBUF tmp;
+
+	strbuf_check(a);
+	strbuf_check(b);
+
+	tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
+
 unsigned int strbuf_crc32(STRBUF *buf)
 {
 	uLong crc = crc32(0L, Z_NULL, 0);
@@ -294,6 +783,91 @@ unsigned int strbuf_crc32(STRBUF *buf)
 	return (unsigned int)crc;
 }
 
+void strbuf_truncate(STRBUF *buf, size_t len)
+{
+	strbuf_check(buf);
+
+	if (len < buf->len) {
+		buf->len = len;
+		buf->data[len] = '\0';
+	}
+}
+
+char *strbuf_reserve(STRBUF *buf, size_t n)
+{
+	strbuf_check(buf);
+
+	if (buf->len + n + 1 > buf->buf_sz)
+		strbuf_grow(buf, buf->len + n + 1);
+	return buf->data + buf->len;
+}
+
+void strbuf_commit(STRBUF *buf, size_t n)
+{
+	buf->len += n;
+	buf->data[buf->len] = '\0';
+
+	strbuf_check(buf);
+}
+
+void strbuf_rewrite_init(struct strbuf_rewrite *rw, STRBUF *buf)
+{
+	rw->buf = buf;
+	rw->out = NULL;
+	rw->w = 0;
+	rw->r = 0;
+}
+
+void strbuf_rewrite_keep(struct strbuf_rewrite *rw, size_t pos)
+{
+	char *data = rw->buf->data;
+
+	if (rw->out)
+		strbuf_append_n(rw->out, data + rw->r, pos - rw->r);
+	else if (rw->w != rw->r) {
+		memmove(data + rw->w, data + rw->r, pos - rw->r);
+		count_move(pos - rw->r);
+	}
+	if (!rw->out)
+		rw->w += pos - rw->r;
+	rw->r = pos;
+}
+
+void strbuf_rewrite_skip(struct strbuf_rewrite *rw, size_t pos)
+{
+	rw->r = pos;
+}
+
+void strbuf_rewrite_put(struct strbuf_rewrite *rw, const char *str,
+			size_t n)
+{
+	if (!rw->out && rw->w + n > rw->r) {
+		rw->out = strbuf_new();
+		rw->out->opt = rw->buf->opt;
+		strbuf_append_n(rw->out, rw->buf->data, rw->w);
+	}
+
+	if (rw->out) {
+		strbuf_append_n(rw->out, str, n);
+	} else {
+		memmove(rw->buf->data + rw->w, str, n);
+		count_copy(n);
+		rw->w += n;
+	}
+}
+
+void strbuf_rewrite_finish(struct strbuf_rewrite *rw)
+{
+	strbuf_rewrite_keep(rw, rw->buf->len);
+	if (rw->out) {
+		strbuf_swap(rw->buf, rw->out);
+		strbuf_free(rw->out);
+		rw->out = NULL;
+	} else {
+		strbuf_truncate(rw->buf, rw->w);
+	}
+}
+
 void strbuf_setopt(STRBUF *buf, enum strbuf_opt opt)
 {
 	buf->opt |= opt;
@@ -303,3 +877,48 @@ void strbuf_unsetopt(STRBUF *buf, enum strbuf_opt opt)
 {
 	buf->opt &= ~opt;
 }
+
+void strbuf_pool_trim(void)
+{
+	struct bufpool *p = pool_this(0);
+	size_t keep;
+	char *data;
+	int c;
+
+	if (!p)
+		return;
+
+	/* small blocks are cheapest to get back from malloc */
+	keep = p->high > p->live ? p->high - p->live : 0;
+	for (c = 0; c < POOL_CLASSES && p->cached > keep; c++) {
+		while (p->cached > keep && (data = p->free[c])) {
+			memcpy(&p->free[c], data, sizeof(char *));
+			block_destroy(data, class_size(c));
+			p->cached -= class_size(c);
+		}
+	}
+	/* decay, so that a small document does not empty the pool */
+	p->high = p->live + keep / 2;
+}
+
+void strbuf_pool_flush(void)
+{
+	struct bufpool *p = pool_this(0);
+
+	if (!p)
+		return;
+	pool_empty(p);
+	p->high = p->live;
+}
+
+size_t strbuf_pool_cached(void)
+{
+	struct bufpool *p = pool_this(0);
+
+	return p ? p->cached : 0;
+}
+
+void strbuf_stats(struct strbuf_stats *stats)
+{
+	*stats = pool_this(1)->stats;
+}
@@ -21,6 +21,16 @@ typedef struct strbuf {
 	int opt;
 } STRBUF;
 
+/*
+ * A borrowed piece of text, e.g. of a string buffer.  It owns
+ * nothing and is valid only as long as the text it points to is
+ * neither changed nor freed.  It is not NUL-terminated.
+ */
+typedef struct strview {
+	const char *data;
+	size_t len;
+} STRVIEW;
+
 enum strbuf_opt {
 	STRBUF_NULLOK = 1
 };
@@ -55,6 +65,21 @@ size_t strbuf_append(STRBUF *buf, const char *str);
  */
 size_t strbuf_append_inflate(STRBUF *buf, FILE *in);
 
+/*
+ * Called by strbuf_append_inflate_cb whenever data has been appended
+ * to buf, which is terminated as usual.  It may remove data from the
+ * beginning of buf.  A nonzero return value stops inflating.
+ */
+typedef int (*strbuf_inflate_fn)(STRBUF *buf, void *data);
+
+/*
+ * Like strbuf_append_inflate, but calls fn after every block.  The
+ * return value is the number of characters inflated, which can be
+ * more than the number of characters left in buf.
+ */
+size_t strbuf_append_inflate_cb(STRBUF *buf, FILE *in,
+				strbuf_inflate_fn fn, void *data);
+
 /*
  * Returns a pointer to the contained string.
  */
@@ -65,12 +90,37 @@ const char *strbuf_get(STRBUF *buf);
  */
 size_t strbuf_len(STRBUF *buf);
 
+/*
+ * Returns a view of the contents of buf.
+ */
+STRVIEW strbuf_view(STRBUF *buf);
+
+/*
+ * Returns a view of the n characters at str.
+ */
+STRVIEW strview_n(const char *str, size_t n);
+
+/*
+ * Appends the text of a view to the string buffer.
+ *
+ * Returns the new length of the string buffer.
+ */
+size_t strbuf_append_view(STRBUF *buf, STRVIEW view);
+
 /*
  * Reallocs the data structure in the string buffer to use not more
  * memory than necessary.
  */
 void strbuf_shrink(STRBUF *buf);
 
+/*
+ * Makes room for n more characters and returns a pointer to the end
+ * of the text, where they can be written.  strbuf_commit then adds
+ * the n characters which have been written to the text.
+ */
+char *strbuf_reserve(STRBUF *buf, size_t n);
+void strbuf_commit(STRBUF *buf, size_t n);
+
 /*
  * Creates a string buffer from a *char without copying.
  */
@@ -97,6 +147,49 @@ char *strbuf_spit(STRBUF *buf);
 int strbuf_subst(STRBUF *buf, size_t start, size_t stop,
 	      const char *subst);
 
+/*
+ * Shortens the string buffer to its first len characters.
+ */
+void strbuf_truncate(STRBUF *buf, size_t len);
+
+/*
+ * Rewrites a string buffer from front to back without a second copy
+ * of it.  Kept text and replacements are written over the part of
+ * the buffer which has been read already.  Only if a replacement
+ * would overwrite text which has not been read yet, the result is
+ * continued in a new buffer.
+ */
+struct strbuf_rewrite {
+	STRBUF *buf;
+	STRBUF *out;    /* NULL as long as the rewrite is in place */
+	size_t w;       /* end of the text written in place */
+	size_t r;       /* end of the text read */
+};
+
+void strbuf_rewrite_init(struct strbuf_rewrite *rw, STRBUF *buf);
+
+/*
+ * Keeps the text from the last position read up to pos.
+ */
+void strbuf_rewrite_keep(struct strbuf_rewrite *rw, size_t pos);
+
+/*
+ * Drops the text from the last position read up to pos.
+ */
+void strbuf_rewrite_skip(struct strbuf_rewrite *rw, size_t pos);
+
+/*
+ * Writes n characters from str.  str may point into text which has
+ * been dropped, as long as it has not been written over yet.
+ */
+void strbuf_rewrite_put(struct strbuf_rewrite *rw, const char *str,
+			size_t n);
+
+/*
+ * Keeps the rest of the text and finishes the buffer.
+ */
+void strbuf_rewrite_finish(struct strbuf_rewrite *rw);
+
 /*
  * Set options for the string buffer
  */
@@ -107,10 +200,45 @@ void strbuf_setopt(STRBUF *buf, enum strbuf_opt opt);
  */
 void strbuf_unsetopt(STRBUF *buf, enum strbuf_opt opt);
 
+/*
+ * Exchange the contents and options of two string buffers.
+ */
+void strbuf_swap(STRBUF *a, STRBUF *b);
+
 /*
  * Return the crc32 checksum of the buffer content.
  */
 unsigned int strbuf_crc32(STRBUF *buf);
 
+/*
+ * Backing stores of 4k and more are kept in a pool of the thread when
+ * they are freed and handed out again by later buffers, so that a
+ * conversion in steady state does no large allocations.
+ *
+ * strbuf_pool_trim frees what the pool holds beyond the most memory
+ * that was in use since the last trim, where the use before that
+ * counts half.  Call it between documents.
+ * strbuf_pool_flush frees everything the pool holds.
+ * strbuf_pool_cached returns the number of bytes it holds.
+ */
+void strbuf_pool_trim(void);
+void strbuf_pool_flush(void);
+size_t strbuf_pool_cached(void);
+
+/*
+ * Counts of the memory traffic of the string buffers of the calling
+ * thread since it started.  They are always kept, so that the cost of
+ * a step is the difference of two snapshots taken around it.  Bytes
+ * are only counted as copied by a resize if the text moved.
+ */
+struct strbuf_stats {
+	size_t moved;           /* bytes moved within a buffer */
+	size_t copied;          /* bytes copied into a buffer */
+	size_t reallocs;        /* backing stores resized */
+	size_t realloc_copied;  /* bytes copied to resize them */
+};
+
+void strbuf_stats(struct strbuf_stats *stats);
+
 #endif /* STRBUF_H */
 
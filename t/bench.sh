@@ -0,0 +1,84 @@
+#!/bin/sh
+#
+# bench.sh: Compares the regex engines and the buffer allocations on
+# a document, and the build with another one if given
+#
+# Usage: bench.sh ODT2TXT FILE [RUNS [BASELINE]]
+#
+
+BIN=$1
+DOC=$2
+RUNS=${3:-3}
+BASE=$4
+
+now() {
+	date +%s%N
+}
+
+# prints the fastest of $RUNS runs of the command in milliseconds
+best() {
+	min=
+	i=0
+	while [ $i -lt $RUNS ]; do
+		start=$(now)
+		"$@" > /dev/null
+		end=$(now)
+		ms=$(( (end - start) / 1000000 ))
+		if [ -z "$min" ] || [ $ms -lt $min ]; then
+			min=$ms
+		fi
+		i=$((i + 1))
+	done
+	echo $min
+}
+
+# "default" uses the generated matchers for the fixed patterns
+ENGINES="default posix"
+if $BIN --version | grep -q "^Regex engine: pcre2"; then
+	ENGINES="$ENGINES pcre2"
+fi
+
+printf "%-10s %10s %10s\n" engine "convert ms" "grep ms"
+for e in $ENGINES; do
+	if [ $e = default ]; then
+		unset ODT2TXT_REGEX
+	else
+		ODT2TXT_REGEX=$e
+		export ODT2TXT_REGEX
+	fi
+	conv=$(best $BIN --width=-1 $DOC)
+	grep=$(best $BIN --grep='[A-Z][a-z]+ (ips|dol)[a-z]*' $DOC)
+	printf "%-10s %10s %10s\n" $e $conv $grep
+done
+
+# buffers of 8MB and more are only mapped for large documents
+echo
+printf "%-10s %10s\n" buffers "convert ms"
+for b in malloc mmap huge; do
+	ODT2TXT_BUFFERS=$b
+	export ODT2TXT_BUFFERS
+	conv=$(best $BIN --width=-1 $DOC)
+	printf "%-10s %10s\n" $b $conv
+done
+unset ODT2TXT_BUFFERS
+
+# e.g. the default build against a profiled one, see "make pgo"
+if [ -n "$BASE" ]; then
+	echo
+	printf "%-14s %10s %10s %10s\n" build "convert ms" "utf-16 ms" "grep ms"
+	for b in $BASE $BIN; do
+		conv=$(best $b --width=-1 $DOC)
+		iconv=$(best $b --encoding=UTF-16 $DOC)
+		grep=$(best $b --grep='[A-Z][a-z]+ (ips|dol)[a-z]*' $DOC)
+		printf "%-14s %10s %10s %10s\n" $(basename $b) $conv $iconv $grep
+		if [ $b = $BASE ]; then
+			base_total=$((conv + iconv + grep))
+		else
+			total=$((conv + iconv + grep))
+		fi
+	done
+	if [ $total -gt 0 ]; then
+		printf "speedup        %d.%02dx\n" $((base_total / total)) \
+		       $((base_total * 100 / total % 100))
+	fi
+fi
@@ -0,0 +1,183 @@
+/*
+ * gen-odt.c: Writes a synthetic OpenDocument text for benchmarks
+ *
+ * Copyright (c) 2006-2009 Dennis Stosberg <dennis@stosberg.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2 as published by the Free Software Foundation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "../mem.h"
+#include "../strbuf.h"
+
+static const char *words[] = {
+	"lorem", "ipsum", "dolor", "s\xc3\xaft", "amet", "Gr\xc3\xbc\xc3\x9f" "e",
+	"na\xc3\xafve", "&amp;", "&lt;tag&gt;", "&apos;q&apos;",
+	"\xe2\x80\x94", "\xe2\x80\xa6", "\xe2\x80\x9cquoted\xe2\x80\x9d",
+	"<text:span text:style-name=\"T1\">span</text:span>",
+	"<text:tab/>", "<text:s/>", "<text:line-break/>"
+};
+
+#define NUM_WORDS (sizeof(words) / sizeof(words[0]))
+
+static unsigned long seed = 1;
+
+static unsigned long rnd(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) & 0x7fff;
+}
+
+static void para(STRBUF *doc, int n)
+{
+	int i, len = 20 + (int)(rnd() % 80);
+
+	if (n % 40 == 0) {
+		strbuf_append(doc, "<text:h text:style-name=\"H1\" "
+			      "text:outline-level=\"1\">Chapter</text:h>");
+	} else if (n % 10 == 0) {
+		strbuf_append(doc, "<text:h text:style-name=\"H2\" "
+			      "text:outline-level=\"2\">Section</text:h>");
+	}
+	if (n % 25 == 0) {
+		strbuf_append(doc, "<draw:frame draw:name=\"Picture\" "
+			      "svg:width=\"1in\"><draw:image/></draw:frame>");
+	}
+
+	strbuf_append(doc, "<text:p text:style-name=\"P1\">");
+	for (i = 0; i < len; i++) {
+		if (i)
+			strbuf_append(doc, " ");
+		strbuf_append(doc, words[rnd() % NUM_WORDS]);
+	}
+	strbuf_append(doc, "</text:p>");
+}
+
+static void put16(FILE *f, unsigned int v)
+{
+	fputc(v & 0xff, f);
+	fputc((v >> 8) & 0xff, f);
+}
+
+static void put32(FILE *f, unsigned long v)
+{
+	put16(f, v & 0xffff);
+	put16(f, (v >> 16) & 0xffff);
+}
+
+struct entry {
+	const char *name;
+	const char *data;
+	size_t len;
+	unsigned long crc;
+	unsigned long offset;
+};
+
+/*
+ * Writes the entries to f as a zip archive.  They are stored without
+ * compression, which keeps the benchmark about odt2txt and not zlib.
+ */
+static void write_zip(FILE *f, struct entry *e, int num)
+{
+	unsigned long dir, dir_len;
+	int i;
+
+	for (i = 0; i < num; i++) {
+		e[i].crc = crc32(0, (const Bytef *)e[i].data, (uInt)e[i].len);
+		e[i].offset = (unsigned long)ftell(f);
+		put32(f, 0x04034b50);
+		put16(f, 10);                  /* version needed */
+		put16(f, 0);                   /* flags */
+		put16(f, 0);                   /* stored */
+		put16(f, 0);                   /* time */
+		put16(f, 0);                   /* date */
+		put32(f, e[i].crc);
+		put32(f, e[i].len);
+		put32(f, e[i].len);
+		put16(f, strlen(e[i].name));
+		put16(f, 0);                   /* extra field */
+		fputs(e[i].name, f);
+		fwrite(e[i].data, 1, e[i].len, f);
+	}
+
+	dir = (unsigned long)ftell(f);
+	for (i = 0; i < num; i++) {
+		put32(f, 0x02014b50);
+		put16(f, 20);                  /* version made by */
+		put16(f, 10);
+		put16(f, 0);
+		put16(f, 0);
+		put16(f, 0);
+		put16(f, 0);
+		put32(f, e[i].crc);
+		put32(f, e[i].len);
+		put32(f, e[i].len);
+		put16(f, strlen(e[i].name));
+		put16(f, 0);                   /* extra field */
+		put16(f, 0);                   /* comment */
+		put16(f, 0);                   /* disk */
+		put16(f, 0);                   /* internal attributes */
+		put32(f, 0);                   /* external attributes */
+		put32(f, e[i].offset);
+		fputs(e[i].name, f);
+	}
+	dir_len = (unsigned long)ftell(f) - dir;
+
+	put32(f, 0x06054b50);
+	put16(f, 0);
+	put16(f, 0);
+	put16(f, num);
+	put16(f, num);
+	put32(f, dir_len);
+	put32(f, dir);
+	put16(f, 0);                           /* comment */
+}
+
+int main(int argc, char **argv)
+{
+	static const char mimetype[] = "application/vnd.oasis.opendocument.text";
+	struct entry e[2];
+	STRBUF *doc;
+	FILE *f;
+	int i, paras;
+
+	if (argc != 3 || (paras = atoi(argv[2])) < 1) {
+		fprintf(stderr, "Usage: gen-odt FILE PARAGRAPHS\n");
+		exit(EXIT_FAILURE);
+	}
+
+	doc = strbuf_new();
+	strbuf_append(doc, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+		      "<office:document-content><office:body><office:text>");
+	for (i = 0; i < paras; i++)
+		para(doc, i);
+	strbuf_append(doc, "</office:text></office:body>"
+		      "</office:document-content>");
+
+	e[0].name = "mimetype";
+	e[0].data = mimetype;
+	e[0].len = strlen(mimetype);
+	e[1].name = "content.xml";
+	e[1].data = strbuf_get(doc);
+	e[1].len = strbuf_len(doc);
+
+	f = fopen(argv[1], "wb");
+	if (!f) {
+		fprintf(stderr, "Can't open %s\n", argv[1]);
+		exit(EXIT_FAILURE);
+	}
+	write_zip(f, e, 2);
+	if (fclose(f)) {
+		fprintf(stderr, "Can't write %s\n", argv[1]);
+		exit(EXIT_FAILURE);
+	}
+
+	strbuf_free(doc);
+	return 0;
+}
@@ -0,0 +1,38 @@
+#!/bin/sh
+#
+# pgo-train.sh: Runs an instrumented odt2txt over a generated corpus
+#
+# Usage: pgo-train.sh ODT2TXT GEN-ODT DIR
+#
+# The documents are written to DIR.  The runs cover inflating, the
+# generated matchers and the regex engine, wrapping, the table
+# driven charsets and iconv, as a default build would use them.
+#
+
+BIN=$1
+GEN=$2
+DIR=$3
+
+mkdir -p $DIR || exit 1
+$GEN $DIR/small.odt 200 || exit 1
+$GEN $DIR/medium.odt 5000 || exit 1
+$GEN $DIR/large.odt 40000 || exit 1
+
+run() {
+	"$@" > /dev/null || exit 1
+}
+
+for doc in $DIR/small.odt $DIR/medium.odt $DIR/large.odt; do
+	run $BIN --jobs=1 --encoding=UTF-8 $doc
+	run $BIN --jobs=1 --encoding=UTF-8 --width=-1 $doc
+	run $BIN --jobs=1 --encoding=ISO-8859-1 $doc
+	run $BIN --jobs=1 --encoding=ISO-8859-15 --subst=all $doc
+	run $BIN --jobs=1 --encoding=UTF-16 --width=40 $doc
+	run $BIN --jobs=1 --encoding=ASCII $doc
+	run $BIN --stats-only $doc
+	run $BIN --grep='lorem (ipsum|dolor)' $doc
+	run env ODT2TXT_REGEX=posix $BIN --jobs=1 --encoding=UTF-8 $doc
+done
+
+# several files go through the worker pool
+run $BIN --jobs=2 --encoding=UTF-8 $DIR/small.odt $DIR/medium.odt
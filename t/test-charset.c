@@ -0,0 +1,173 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef NO_ICONV
+#  include <iconv.h>
+#endif
+
+#include "../mem.h"
+#include "../strbuf.h"
+#include "../charset.h"
+
+#ifndef ICONV_CHAR
+#define ICONV_CHAR char
+#endif
+
+static size_t encode(char *out, unsigned long ucs)
+{
+	if (ucs < 0x80) {
+		out[0] = (char)ucs;
+		return 1;
+	} else if (ucs < 0x800) {
+		out[0] = (char)(0xc0 | (ucs >> 6));
+		out[1] = (char)(0x80 | (ucs & 0x3f));
+		return 2;
+	} else if (ucs < 0x10000) {
+		out[0] = (char)(0xe0 | (ucs >> 12));
+		out[1] = (char)(0x80 | ((ucs >> 6) & 0x3f));
+		out[2] = (char)(0x80 | (ucs & 0x3f));
+		return 3;
+	}
+	out[0] = (char)(0xf0 | (ucs >> 18));
+	out[1] = (char)(0x80 | ((ucs >> 12) & 0x3f));
+	out[2] = (char)(0x80 | ((ucs >> 6) & 0x3f));
+	out[3] = (char)(0x80 | (ucs & 0x3f));
+	return 4;
+}
+
+static void check(const struct charset *cs, const char *in, size_t len,
+		  const char *expect, size_t expect_len)
+{
+	STRBUF *out = charset_conv(cs, in, len);
+
+	assert(strbuf_len(out) == expect_len);
+	assert(!memcmp(strbuf_get(out), expect, expect_len));
+	strbuf_free(out);
+
+	/* the same in place */
+	out = strbuf_new();
+	strbuf_setopt(out, STRBUF_NULLOK);
+	strbuf_append_n(out, in, len);
+	charset_conv_buf(cs, out);
+	assert(strbuf_len(out) == expect_len);
+	assert(!memcmp(strbuf_get(out), expect, expect_len));
+	strbuf_free(out);
+}
+
+static void repair(const char *in, const char *expect, size_t count)
+{
+	STRBUF *buf = strbuf_new();
+
+	strbuf_append(buf, in);
+	assert(utf8_repair(buf) == count);
+	assert(!strcmp(strbuf_get(buf), expect));
+	strbuf_free(buf);
+}
+
+#ifndef NO_ICONV
+/*
+ * Every character must give the same byte as iconv, or '?' where
+ * iconv fails.
+ */
+static void compare_iconv(const char *name)
+{
+	const struct charset *cs = charset_find(name);
+	iconv_t ic = iconv_open(name, "UTF-8");
+	unsigned long ucs;
+	char utf8[4], expect, *out;
+	ICONV_CHAR *in;
+	size_t len, inleft, outleft;
+	STRBUF *res;
+
+	assert(cs);
+	assert(ic != (iconv_t)-1);
+
+	for (ucs = 0; ucs < 0x110000; ucs++) {
+		if (ucs >= 0xd800 && ucs < 0xe000)
+			continue;
+		len = encode(utf8, ucs);
+
+		in = utf8;
+		inleft = len;
+		out = &expect;
+		outleft = 1;
+		if (iconv(ic, &in, &inleft, &out, &outleft) == (size_t)-1) {
+			assert(errno == EILSEQ);
+			expect = '?';
+		}
+		iconv(ic, NULL, NULL, NULL, NULL);
+
+		res = charset_conv(cs, utf8, len);
+		assert(strbuf_len(res) == 1);
+		assert(*strbuf_get(res) == expect);
+		assert(charset_has(cs, utf8) == (expect != '?' || ucs == '?'));
+		strbuf_free(res);
+	}
+	iconv_close(ic);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+	const struct charset *latin1, *latin9, *cp1252, *ascii;
+	char text[100], expect[99];
+
+	latin1 = charset_find("ISO-8859-1");
+	latin9 = charset_find("iso8859_15");
+	cp1252 = charset_find("Windows-1252");
+	ascii = charset_find("ANSI_X3.4-1968");
+	assert(latin1 && latin9 && cp1252 && ascii);
+	assert(charset_find("latin1") == latin1);
+	assert(charset_find("UTF-8") == NULL);
+	assert(charset_find("ISO-8859-1//TRANSLIT") == NULL);
+
+	check(latin1, "", 0, "", 0);
+	check(latin1, "caf\xc3\xa9", 5, "caf\xe9", 4);
+	check(latin9, "\xe2\x82\xac 5", 5, "\xa4 5", 3);
+	check(latin1, "\xe2\x82\xac 5", 5, "? 5", 3);
+	check(cp1252, "\xe2\x80\x9cq\xe2\x80\x9d", 7, "\x93q\x94", 3);
+	check(ascii, "na\xc3\xafve", 6, "na?ve", 5);
+
+	/* invalid sequences are skipped like conv does */
+	check(latin1, "a\x80" "b", 3, "a?b", 3);
+	check(latin1, "\xc3" "A", 2, "?", 1);
+	check(latin1, "\xed\xa0\x80z", 4, "?z", 2);
+	check(latin1, "x\xe2\x82", 3, "x?", 2);
+
+	/* the ASCII fast path must stop at the first non-ASCII byte */
+	memset(text, 'a', sizeof(text));
+	text[37] = '\xc3';
+	text[38] = '\xa4';
+	memset(expect, 'a', sizeof(expect));
+	expect[37] = '\xe4';
+	check(latin1, text, sizeof(text), expect, sizeof(expect));
+
+	/* validation */
+	assert(utf8_valid_len("caf\xc3\xa9", 5) == 5);
+	assert(utf8_valid_len("caf\xc3", 4) == 3);
+	assert(utf8_valid_len(text, sizeof(text)) == sizeof(text));
+	assert(utf8_valid_len("ab\xed\xa0\x80", 5) == 2);
+
+	/* every invalid sequence becomes a single '?' */
+	repair("", "", 0);
+	repair("gr\xc3\xbc\xc3\x9f", "gr\xc3\xbc\xc3\x9f", 0);
+	repair("a\x80" "b", "a?b", 1);
+	repair("\xc3" "A", "?A", 1);
+	repair("\xc0\xaf", "??", 2);
+	repair("\xe2\x82 end", "? end", 1);
+	repair("\xed\xa0\x80z", "???z", 3);
+	repair("\xf0\x9f\x98", "?", 1);
+	repair("x\xffy\xf4\x90", "x?y??", 3);
+
+#ifndef NO_ICONV
+	compare_iconv("ISO-8859-1");
+	compare_iconv("ISO-8859-15");
+	compare_iconv("CP1252");
+	compare_iconv("US-ASCII");
+#endif
+
+	printf("ALL HAPPY\n");
+	return 0;
+}
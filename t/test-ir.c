@@ -0,0 +1,63 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../mem.h"
+#include "../strbuf.h"
+#include "../ir.h"
+
+static void roundtrip(const char *doc, size_t len)
+{
+	STRBUF *buf, *ir, *out;
+
+	buf = strbuf_new();
+	strbuf_append_n(buf, doc, len);
+
+	ir = ir_encode(buf);
+	out = ir_decode(ir);
+	assert(out);
+	assert(strbuf_len(out) == len);
+	assert(!memcmp(strbuf_get(out), doc, len));
+
+	strbuf_free(out);
+	strbuf_free(ir);
+	strbuf_free(buf);
+}
+
+int main(int argc, char **argv)
+{
+	STRBUF *buf, *ir;
+	const char *test1 = "\n\n\001=Brave new world\002\n\nText\nmore text\n\n\n";
+	const char *test2 = "\001-\002\001=x\002no newline";
+	char big[1000];
+
+	roundtrip("", 0);
+	roundtrip(test1, strlen(test1));
+	roundtrip(test2, strlen(test2));
+
+	/* marks without a type are text */
+	roundtrip("text\n\n\001", 7);
+	roundtrip("\001x\001\001-y\002", 7);
+
+	/* long runs need multi-byte lengths */
+	memset(big, 'a', sizeof(big));
+	big[500] = '\n';
+	roundtrip(big, sizeof(big));
+
+	/* one break record for a run of newlines */
+	buf = strbuf_new();
+	strbuf_append(buf, "a\n\n\nb");
+	ir = ir_encode(buf);
+	assert(strbuf_len(ir) == 3 + 2 + 3 + 2);
+	assert(strbuf_get(ir)[3] == IR_BREAK && strbuf_get(ir)[4] == 3);
+	strbuf_free(buf);
+
+	/* truncated input is rejected */
+	ir->len -= 3;
+	assert(ir_decode(ir) == NULL);
+	strbuf_free(ir);
+
+	printf("ALL HAPPY\n");
+	return(EXIT_SUCCESS);
+}
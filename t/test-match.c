@@ -0,0 +1,79 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../mem.h"
+#include "../matchers.h"
+
+/*
+ * Builds a random subject from pieces of the pattern itself and a
+ * few other characters, so that partial and complete matches are
+ * frequent.
+ */
+static size_t subject(char *s, size_t size, const char *regex)
+{
+	static const char other[] = "x \n<>\"=";
+	size_t rlen = strlen(regex);
+	size_t len = 0, n, from;
+	const char *src;
+
+	while (len < size / 2 && rand() % 8) {
+		if (rand() % 3) {
+			src = regex;
+			from = (size_t)rand() % rlen;
+			n = 1 + (size_t)rand() % 12;
+			if (n > rlen - from)
+				n = rlen - from;
+		} else {
+			src = other;
+			from = (size_t)rand() % (sizeof(other) - 1);
+			n = 1;
+		}
+		memcpy(s + len, src + from, n);
+		len += n;
+	}
+	return len;
+}
+
+static void compare(const struct matcher *mt, const char *s, size_t len)
+{
+	regex_t rx;
+	regmatch_t expect[3], got[3];
+	int r1, r2, i;
+
+	assert(regcomp(&rx, mt->regex, REG_EXTENDED) == 0);
+	expect[0].rm_so = 0;
+	expect[0].rm_eo = len;
+	r1 = regexec(&rx, s, 3, expect, REG_STARTEND) == 0;
+	r2 = mt->match(s, len, got, 3);
+	assert(r1 == r2);
+	for (i = 0; r1 && i <= (int)rx.re_nsub && i < 3; i++) {
+		assert(expect[i].rm_so == got[i].rm_so);
+		assert(expect[i].rm_eo == got[i].rm_eo);
+	}
+	regfree(&rx);
+}
+
+int main(int argc, char **argv)
+{
+	const struct matcher *mt;
+	char s[200];
+	size_t len;
+	int i;
+
+	assert(matcher_find("&amp;"));
+	assert(!matcher_find("no such pattern"));
+
+	srand(1);
+	for (mt = matchers; mt->regex; mt++) {
+		compare(mt, "", 0);
+		for (i = 0; i < 20000; i++) {
+			len = subject(s, sizeof(s), mt->regex);
+			compare(mt, s, len);
+		}
+	}
+
+	printf("ALL HAPPY\n");
+	return 0;
+}
@@ -0,0 +1,70 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../odf.h"
+
+static const char *names[] = {
+	NULL,
+#define ODF_ELEMENT(id, name) name,
+	ODF_ELEMENTS
+#undef ODF_ELEMENT
+};
+
+static enum odf_element lookup(const char *name)
+{
+	return odf_element(name, strlen(name));
+}
+
+int main(int argc, char **argv)
+{
+	const char *doc = "a<text:p text:style-name=\"P1\">b<text:tab/>"
+		"</text:p><?xml?><x:y\n/>c<d";
+	const char *end = doc + strlen(doc);
+	struct odf_tag tag;
+	char name[32];
+	int i;
+
+	/* every known element is found, and nothing else */
+	for (i = 1; i < ODF_NUM_ELEMENTS; i++) {
+		assert(lookup(names[i]) == (enum odf_element)i);
+
+		strcpy(name, names[i]);
+		name[strlen(name) - 1] ^= 1;
+		assert(lookup(name) == ODF_UNKNOWN);
+		assert(odf_element(names[i], strlen(names[i]) - 1) !=
+		       (enum odf_element)i);
+	}
+	assert(lookup("") == ODF_UNKNOWN);
+	assert(lookup("text:paragraph") == ODF_UNKNOWN);
+	assert(lookup("office:document-content-and-more") == ODF_UNKNOWN);
+	assert(lookup("TEXT:P") == ODF_UNKNOWN);
+	assert(odf_element("text:pp", 6) == ODF_TEXT_P);
+
+	/* tags */
+	assert(odf_next_tag(doc, end, &tag));
+	assert(tag.start == doc + 1 && tag.elem == ODF_TEXT_P);
+	assert(!tag.closing && !tag.empty && tag.name_len == 6);
+	assert(tag.name[tag.name_len] == ' ');
+
+	assert(odf_next_tag(tag.end, end, &tag));
+	assert(tag.elem == ODF_TEXT_TAB && tag.empty);
+	assert(odf_tag_is(&tag, "<text:tab/>"));
+
+	assert(odf_next_tag(tag.end, end, &tag));
+	assert(tag.elem == ODF_TEXT_P && tag.closing);
+	assert(odf_tag_is(&tag, "</text:p>"));
+
+	assert(odf_next_tag(tag.end, end, &tag));
+	assert(tag.elem == ODF_UNKNOWN && tag.name_len == 5);
+
+	assert(odf_next_tag(tag.end, end, &tag));
+	assert(tag.elem == ODF_UNKNOWN && tag.name_len == 3 && tag.empty);
+
+	/* a '<' without '>' is text */
+	assert(!odf_next_tag(tag.end, end, &tag));
+
+	printf("ALL HAPPY\n");
+	return 0;
+}
@@ -0,0 +1,64 @@
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../mem.h"
+#include "../strbuf.h"
+#include "../paraidx.h"
+
+int main(int argc, char **argv)
+{
+	struct paraidx idx, copy;
+	STRBUF *buf;
+	size_t start, end;
+	size_t i;
+
+	/* encoding and decoding */
+	paraidx_init(&idx);
+	paraidx_add(&idx, 1, 1);
+	paraidx_add(&idx, 20, 0);
+	paraidx_add(&idx, 300, 0);
+	paraidx_add(&idx, 310, 1);
+	paraidx_add(&idx, 100000, 0);
+	paraidx_end(&idx, 100005);
+
+	buf = paraidx_encode(&idx);
+	assert(paraidx_decode(&copy, strbuf_get(buf), strbuf_len(buf)) == 0);
+	assert(copy.count == 5);
+	for (i = 0; i <= idx.count; i++)
+		assert(copy.offsets[i] == idx.offsets[i]);
+	for (i = 0; i < idx.count; i++)
+		assert(copy.headline[i] == idx.headline[i]);
+	paraidx_free(&copy);
+
+	/* truncated and trailing data */
+	assert(paraidx_decode(&copy, strbuf_get(buf), strbuf_len(buf) - 1) == -1);
+	strbuf_append_n(buf, "", 1);
+	assert(paraidx_decode(&copy, strbuf_get(buf), strbuf_len(buf)) == -1);
+	assert(paraidx_decode(&copy, "odt2txt", 7) == -1);
+
+	/* paragraph ranges */
+	assert(paraidx_range(&idx, 0, 2, 3, &start, &end) == 0);
+	assert(start == 20 && end == 310);
+	assert(paraidx_range(&idx, 0, 5, 9, &start, &end) == 0);
+	assert(start == 100000 && end == 100005);
+	assert(paraidx_range(&idx, 0, 6, 6, &start, &end) == -1);
+	assert(paraidx_range(&idx, 0, 0, 1, &start, &end) == -1);
+
+	/* headline ranges run to the next headline */
+	assert(paraidx_range(&idx, 1, 1, 1, &start, &end) == 0);
+	assert(start == 1 && end == 310);
+	assert(paraidx_range(&idx, 1, 2, 2, &start, &end) == 0);
+	assert(start == 310 && end == 100005);
+	assert(paraidx_range(&idx, 1, 1, (size_t)-1, &start, &end) == 0);
+	assert(start == 1 && end == 100005);
+	assert(paraidx_range(&idx, 1, 3, 3, &start, &end) == -1);
+
+	paraidx_free(&idx);
+	strbuf_free(buf);
+
+	printf("ALL HAPPY\n");
+	return(EXIT_SUCCESS);
+}
@@ -8,9 +8,59 @@
 #include "../strbuf.h"
 #include "../regex.h"
 
+static size_t paras[8][2];
+static size_t num_paras;
+
+static void para(size_t offset, size_t chars, void *data)
+{
+	paras[num_paras][0] = offset;
+	paras[num_paras][1] = chars;
+	num_paras++;
+}
+
+static int num_lines;
+
+static int grep_line(const char *line, size_t len, void *data)
+{
+	assert(len >= 1 && line[0] == 't');
+	num_lines++;
+	return 0;
+}
+
+/*
+ * Checks the first match of a pattern which has no generated
+ * matcher, so that it runs on the regex engine.
+ */
+static void regex_match(const char *regex, const char *s, int so, int eo)
+{
+	char err[256];
+	regmatch_t m[1];
+	RX *rx = rx_compile(regex, 0, err, sizeof(err));
+
+	assert(rx);
+	if (so == -1) {
+		assert(!rx_exec(rx, s, strlen(s), m, 1));
+	} else {
+		assert(rx_exec(rx, s, strlen(s), m, 1));
+		assert(m[0].rm_so == so && m[0].rm_eo == eo);
+	}
+	rx_free(rx);
+}
+
+static int count_line(const char *line, size_t len, void *data)
+{
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
-	STRBUF *buf;
+	STRBUF *buf, *wbuf;
+	STRVIEW view;
+	RX *rx;
+	struct rx_iter it;
+	regmatch_t m[2];
+	char err[256];
+	struct regex_stats before, after;
 	char *test1 = "When shall we three meet again?";
 	char *test2 = "In thunder, lightning, or in rain?";
 	char *test3 =
@@ -39,6 +89,15 @@ int main(int argc, char **argv)
 	assert(!strcmp(strbuf_get(buf), "I thude, lightig, o i ai?"));
 	strbuf_free(buf);
 
+	/* replacements are not matched again */
+	buf = strbuf_new();
+	strbuf_append(buf, "&amp;amp; &amp;lt;");
+	assert( 2 == regex_subst(buf, "&amp;", _REG_GLOBAL, "&"));
+	assert(!strcmp(strbuf_get(buf), "&amp; &lt;"));
+	assert( 1 == regex_subst(buf, "&", _REG_DEFAULT, "and "));
+	assert(!strcmp(strbuf_get(buf), "and amp; &lt;"));
+	strbuf_free(buf);
+
 	/* global rm to empty string */
 	buf = strbuf_new();
 	strbuf_append(buf, test3);
@@ -55,6 +114,87 @@ int main(int argc, char **argv)
 	assert(!strcmp(strbuf_get(buf), "abcdefghi"));
 	strbuf_free(buf);
 
+	/* compiled patterns, with and without a generated matcher */
+	rx = rx_compile("(b+)c", 0, err, sizeof(err));
+	assert(rx);
+	assert(rx_exec(rx, "aabbbcd", 7, m, 2));
+	assert(m[0].rm_so == 2 && m[0].rm_eo == 6);
+	assert(m[1].rm_so == 2 && m[1].rm_eo == 5);
+	assert(!rx_exec(rx, "aabbbcd", 5, m, 2));
+	rx_free(rx);
+
+	rx = rx_compile("x(y", 0, err, sizeof(err));
+	assert(!rx && err[0]);
+
+	rx = rx_compile("<[^>]*>", 0, err, sizeof(err));
+	assert(rx);
+	assert(rx_exec(rx, "a<b>c", 5, m, 1));
+	assert(m[0].rm_so == 1 && m[0].rm_eo == 4);
+	rx_free(rx);
+
+	/* all matches in one scan, empty ones included */
+	rx = rx_compile("x*", 0, err, sizeof(err));
+	assert(rx);
+	rx_iter_init(&it, rx, "ax\xc3\xa4", 4);
+	assert(rx_iter_next(&it, m, 1));
+	assert(m[0].rm_so == 0 && m[0].rm_eo == 0);
+	assert(rx_iter_next(&it, m, 1));
+	assert(m[0].rm_so == 1 && m[0].rm_eo == 2);
+	assert(rx_iter_next(&it, m, 1));
+	assert(m[0].rm_so == 2 && m[0].rm_eo == 2);
+	assert(rx_iter_next(&it, m, 1));
+	assert(m[0].rm_so == 4 && m[0].rm_eo == 4);
+	assert(!rx_iter_next(&it, m, 1));
+	assert(!rx_iter_next(&it, m, 1));
+	rx_free(rx);
+
+	/* ^ does not match in the middle of the text */
+	rx = rx_compile("^a", 0, err, sizeof(err));
+	assert(rx);
+	rx_iter_init(&it, rx, "aaa", 3);
+	assert(rx_iter_next(&it, m, 1));
+	assert(!rx_iter_next(&it, m, 1));
+	rx_free(rx);
+
+	/* the text is not NUL-terminated */
+	rx = rx_compile("ab", 0, err, sizeof(err));
+	assert(rx);
+	rx_iter_init(&it, rx, "xabab", 4);
+	assert(rx_iter_next(&it, m, 1));
+	assert(m[0].rm_so == 1);
+	assert(!rx_iter_next(&it, m, 1));
+	rx_free(rx);
+
+	/* only the part of a pattern which every match starts with */
+	regex_match("ab*c", "xac", 1, 3);
+	regex_match("ab+c", "xac", -1, -1);
+	regex_match("ab+c", "xabbc", 1, 5);
+	regex_match("a?bc", "xbc", 1, 3);
+	regex_match("a{0}bc", "xbc", 1, 3);
+	regex_match("\\.x", "a.x", 1, 3);
+	regex_match("x\\.y", "x.x.y", 2, 5);
+	regex_match("ab|cd", "xcd", 1, 3);
+	regex_match("\xc3\xbc+x", "a\xc3\xbcx", 1, 4);
+	regex_match("<text:p[^>]*>", "<text:<text:p a>", 6, 16);
+
+	/* grep */
+	rx = rx_compile("^t", RX_NEWLINE, err, sizeof(err));
+	assert(rx);
+	assert(2 == regex_grep(rx, "two\none\nthree", 14, grep_line, NULL));
+	assert(num_lines == 2);
+	rx_free(rx);
+
+	rx = rx_compile("o[^x]*e", RX_NEWLINE, err, sizeof(err));
+	assert(rx);
+	assert(1 == regex_grep(rx, "two\none\nthe\n", 13, count_line, NULL));
+	rx_free(rx);
+
+	rx = rx_compile("^$", RX_NEWLINE, err, sizeof(err));
+	assert(rx);
+	assert(1 == regex_grep(rx, "t\n\nt\n", 5, count_line, NULL));
+	assert(0 == regex_grep(rx, "", 0, count_line, NULL));
+	rx_free(rx);
+
 	/* underline 1 */
 	c = underline('=', "Brave new world");
 	assert(!strcmp(c, "Brave new world\n===============\n\n"));
@@ -75,6 +215,56 @@ int main(int argc, char **argv)
 	assert(!strcmp(c, ""));
 	yfree(c);
 
+	/* wrap drops trailing spaces */
+	buf = strbuf_new();
+	strbuf_append(buf, "one two  \nthree four five  six\n\n\xc3\xa4 seven\n");
+	c = strbuf_spit(wrap(buf, 10));
+	assert(!strcmp(c, "\none two\nthree four\nfive  six\n\n\xc3\xa4 seven\n\n"));
+	yfree(c);
+
+	/* paragraph offsets */
+	c = strbuf_spit(wrap_para(buf, -1, para, NULL));
+	assert(!strcmp(c, "one two\nthree four five  six\n\n\xc3\xa4 seven\n"));
+	assert(num_paras == 3);
+	assert(paras[0][0] == 0 && paras[0][1] == 0);
+	assert(paras[1][0] == 30 && paras[1][1] == 30);
+	assert(paras[2][0] == 39 && paras[2][1] == 38);
+	yfree(c);
+	strbuf_free(buf);
+
+	/* unwrapped text without trailing spaces is not copied */
+	buf = strbuf_new();
+	strbuf_append(buf, "one two\n\nthree  ");
+	view = wrap_view(buf, -1, &wbuf);
+	assert(!wbuf && view.data == strbuf_get(buf) && view.len == 16);
+	strbuf_append(buf, "\n");
+	view = wrap_view(buf, -1, &wbuf);
+	assert(wbuf && view.len == 15);
+	strbuf_free(wbuf);
+	strbuf_free(buf);
+
+	/* a paragraph after a line broken in its trailing spaces */
+	buf = strbuf_new();
+	strbuf_append(buf, "aaaa bbbb   \n\ncc\n");
+	num_paras = 0;
+	c = strbuf_spit(wrap_para(buf, 5, para, NULL));
+	assert(!strcmp(c, "\naaaa\nbbbb\n\n\ncc\n\n"));
+	assert(num_paras == 3);
+	assert(paras[1][0] == 13);
+	yfree(c);
+	strbuf_free(buf);
+
+	/* every substitution is one pass */
+	buf = strbuf_new();
+	strbuf_append(buf, "a-b-c");
+	regex_stats(&before);
+	assert(regex_subst(buf, "-", _REG_GLOBAL, "+") == 2);
+	assert(regex_subst(buf, "x", _REG_GLOBAL, "+") == 0);
+	regex_stats(&after);
+	assert(after.passes - before.passes == 2);
+	assert(after.matches - before.matches == 2);
+	assert(after.scanned - before.scanned == 10);
+	strbuf_free(buf);
 
 	printf("ALL HAPPY\n");
 	return(EXIT_SUCCESS);
@@ -3,13 +3,79 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <zlib.h>
 
 #include "../mem.h"
 #include "../strbuf.h"
 
+/* counts the blocks it has handed out and not taken back */
+static void *count_malloc(void *ctx, size_t size)
+{
+	++*(long *)ctx;
+	return malloc(size);
+}
+
+static void *count_realloc(void *ctx, void *p, size_t size)
+{
+	return realloc(p, size);
+}
+
+static void count_free(void *ctx, void *p)
+{
+	--*(long *)ctx;
+	free(p);
+}
+
+/* writes str times times to a temporary file as a raw deflate stream */
+static FILE *deflated(const char *str, size_t times)
+{
+	FILE *f = tmpfile();
+	unsigned char out[4096];
+	z_stream strm;
+	size_t i;
+
+	assert(f);
+	memset(&strm, 0, sizeof(strm));
+	assert(deflateInit2(&strm, 9, Z_DEFLATED, -15, 8,
+			    Z_DEFAULT_STRATEGY) == Z_OK);
+	for (i = 0; i <= times; i++) {
+		strm.next_in = (Bytef *)str;
+		strm.avail_in = i < times ? (uInt)strlen(str) : 0;
+		do {
+			strm.next_out = out;
+			strm.avail_out = sizeof(out);
+			deflate(&strm, i < times ? Z_NO_FLUSH : Z_FINISH);
+			fwrite(out, 1, sizeof(out) - strm.avail_out, f);
+		} while (strm.avail_out == 0);
+	}
+	deflateEnd(&strm);
+	rewind(f);
+	return f;
+}
+
+/* keeps only the last character, like a parser waiting for more */
+static int keep_last(STRBUF *buf, void *data)
+{
+	size_t len = strbuf_len(buf);
+
+	assert(strbuf_get(buf)[len] == '\0');
+	*(size_t *)data += len ? len - 1 : 0;
+	if (len > 1)
+		strbuf_subst(buf, 0, len - 1, "");
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
-	STRBUF *buf;
+	STRBUF *buf, *buf2;
+	STRVIEW view;
+	struct strbuf_rewrite rw;
+	struct strbuf_stats before, after;
+	struct allocator counting = {
+		count_malloc, count_realloc, count_free, NULL
+	};
+	long blocks = 0;
+	const char *data;
 	char *test1 = "When shall we three meet again?";
 	char *test2 = "In thunder, lightning, or in rain?";
 	char *test3 =
@@ -19,6 +85,13 @@ int main(int argc, char **argv)
 		"do do do do do do do do do do "
 		"do do do do do do do do do do ";
 	char *c;
+	size_t i, n;
+	FILE *f;
+
+#ifndef WIN32
+	/* map the large blocks below, in the most involved way */
+	setenv("ODT2TXT_BUFFERS", "huge", 1);
+#endif
 
 	/* trivial */
 	buf = strbuf_new();
@@ -74,10 +147,127 @@ int main(int argc, char **argv)
 	/* slurp */
 	c = ymalloc(strlen(test2) + 1);
 	memcpy(c, test2, strlen(test2) + 1);
-	buf = strbuf_create_slurp(c);
+	buf = strbuf_slurp(c);
 	assert(!strcmp(test2, strbuf_get(buf)));
+
+	/* swap */
+	buf2 = strbuf_new();
+	strbuf_append(buf2, test3);
+	strbuf_swap(buf, buf2);
+	assert(!strcmp(test3, strbuf_get(buf)));
+	assert(!strcmp(test2, strbuf_get(buf2)));
+	strbuf_free(buf2);
+
+	/* views borrow the text */
+	view = strbuf_view(buf);
+	assert(view.data == strbuf_get(buf) && view.len == strlen(test3));
+	buf2 = strbuf_new();
+	strbuf_append_view(buf2, strview_n(view.data + 1, 3));
+	assert(!strcmp(strbuf_get(buf2), "o d"));
+	strbuf_free(buf2);
+	strbuf_free(buf);
+
+	/* rewriting in place, and in a new buffer once it grows */
+	buf = strbuf_new();
+	strbuf_append(buf, "a<b>c<d>e");
+	strbuf_rewrite_init(&rw, buf);
+	strbuf_rewrite_keep(&rw, 1);
+	strbuf_rewrite_skip(&rw, 4);
+	strbuf_rewrite_put(&rw, "B", 1);
+	strbuf_rewrite_keep(&rw, 5);
+	strbuf_rewrite_skip(&rw, 8);
+	strbuf_rewrite_put(&rw, "DDD", 3);
+	assert(!rw.out);
+	strbuf_rewrite_put(&rw, "!!!", 3);
+	assert(rw.out);
+	strbuf_rewrite_finish(&rw);
+	assert(!strcmp(strbuf_get(buf), "aBcDDD!!!e"));
 	strbuf_free(buf);
 
+	buf = strbuf_new();
+	strbuf_append(buf, "a<b>c");
+	data = strbuf_get(buf);
+	strbuf_rewrite_init(&rw, buf);
+	strbuf_rewrite_keep(&rw, 1);
+	strbuf_rewrite_skip(&rw, 4);
+	strbuf_rewrite_finish(&rw);
+	assert(!strcmp(strbuf_get(buf), "ac") && strbuf_get(buf) == data);
+	strbuf_free(buf);
+
+	/* the callback gets a terminated buffer, even when inflate
+	   has filled it */
+	f = deflated(test3, 10000);
+	buf = strbuf_new();
+	n = 0;
+	assert(strbuf_append_inflate_cb(buf, f, keep_last, &n)
+	       == strlen(test3) * 10000);
+	assert(n + strbuf_len(buf) == strlen(test3) * 10000);
+	assert(!strcmp(strbuf_get(buf), " "));
+	strbuf_free(buf);
+	fclose(f);
+
+	/* memory traffic is counted */
+	buf = strbuf_new();
+	strbuf_stats(&before);
+	strbuf_append(buf, "abcdef");
+	strbuf_subst(buf, 1, 3, "X");
+	strbuf_stats(&after);
+	assert(!strcmp(strbuf_get(buf), "aXdef"));
+	assert(after.copied - before.copied == 7);
+	assert(after.moved - before.moved == 4);
+	strbuf_free(buf);
+
+	/* large backing stores are recycled */
+	buf = strbuf_new();
+	for (i = 0; i < 1000; i++)
+		strbuf_append(buf, test3);
+	data = strbuf_get(buf);
+	strbuf_free(buf);
+	assert(strbuf_pool_cached() > 0);
+	buf = strbuf_new();
+	memset(strbuf_reserve(buf, 100000), 'x', 100000);
+	strbuf_commit(buf, 100000);
+	assert(strbuf_get(buf) == data && strbuf_len(buf) == 100000);
+	assert(strlen(strbuf_get(buf)) == 100000);
+
+	/* and leave the pool when they are handed out */
+	c = strbuf_spit(buf);
+	assert(strlen(c) == 100000);
+	yfree(c);
+
+	/* mapped blocks are recycled too, and can be shrunk */
+	buf = strbuf_new();
+	memset(strbuf_reserve(buf, 20000000), 'x', 20000000);
+	strbuf_commit(buf, 20000000);
+	data = strbuf_get(buf);
+	strbuf_free(buf);
+	buf = strbuf_new();
+	memset(strbuf_reserve(buf, 20000000), 'y', 20000000);
+	strbuf_commit(buf, 20000000);
+	assert(strbuf_get(buf) == data && strlen(data) == 20000000);
+	strbuf_subst(buf, 10, strbuf_len(buf), "");
+	strbuf_shrink(buf);
+	assert(!strcmp(strbuf_get(buf), "yyyyyyyyyy"));
+	strbuf_free(buf);
+
+	strbuf_pool_trim();
+	assert(strbuf_pool_cached() > 0);
+	strbuf_pool_flush();
+	assert(strbuf_pool_cached() == 0);
+
+	/* allocations go to the allocator of the thread */
+	counting.ctx = &blocks;
+	assert(mem_set_allocator(&counting) == NULL);
+	buf = strbuf_new();
+	for (i = 0; i < 1000; i++)
+		strbuf_append(buf, test3);
+	c = strbuf_spit(buf);
+	assert(blocks > 1);
+	yfree(c);
+	strbuf_pool_flush();
+	assert(blocks == 0);
+	assert(mem_set_allocator(NULL) == &counting);
+
 	printf("ALL HAPPY\n");
 	return(EXIT_SUCCESS);
 }
@@ -0,0 +1,138 @@
+/*
+ * genelem.c: Generates a perfect hash table over the element names
+ *            in odf.h
+ *
+ * Copyright (c) 2006-2009 Dennis Stosberg <dennis@stosberg.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2 as published by the Free Software Foundation
+ */
+
+/*
+ * Usage: genelem > elements.c
+ *
+ * Searches for a seed of the FNV-1a hash which maps every name in
+ * ODF_ELEMENTS to a slot of its own, and writes odf_element with that
+ * seed.  A lookup hashes the name, takes the element in its slot and
+ * compares the name once.  Names longer than the longest element are
+ * rejected before hashing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../odf.h"
+
+#define FNV_PRIME 16777619u
+
+static const char *names[] = {
+	NULL,
+#define ODF_ELEMENT(id, name) name,
+	ODF_ELEMENTS
+#undef ODF_ELEMENT
+};
+
+static const char *ids[] = {
+	"ODF_UNKNOWN",
+#define ODF_ELEMENT(id, name) "ODF_" #id,
+	ODF_ELEMENTS
+#undef ODF_ELEMENT
+};
+
+static unsigned int hash(const char *s, unsigned int seed)
+{
+	unsigned int h = seed;
+
+	while (*s)
+		h = (h ^ (unsigned char)*s++) * FNV_PRIME;
+	return h;
+}
+
+/*
+ * Fills slots for the given seed and table size.  Returns 0 if two
+ * names collide.
+ */
+static int fill(int *slots, unsigned int size, unsigned int seed)
+{
+	unsigned int i, h;
+
+	memset(slots, 0, size * sizeof(*slots));
+	for (i = 1; i < ODF_NUM_ELEMENTS; i++) {
+		h = hash(names[i], seed) & (size - 1);
+		if (slots[h])
+			return 0;
+		slots[h] = (int)i;
+	}
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	static int slots[1024];
+	unsigned int size, seed, i;
+	size_t max_len = 0;
+
+	for (i = 1; i < ODF_NUM_ELEMENTS; i++)
+		if (strlen(names[i]) > max_len)
+			max_len = strlen(names[i]);
+
+	/* the smallest table for which a seed is found quickly */
+	for (size = 16; size < ODF_NUM_ELEMENTS; size *= 2)
+		;
+	for (;; size *= 2) {
+		if (size > sizeof(slots) / sizeof(slots[0])) {
+			fprintf(stderr, "genelem: no perfect hash found\n");
+			exit(EXIT_FAILURE);
+		}
+		for (seed = 2166136261u; seed < 2166136261u + 100000; seed++)
+			if (fill(slots, size, seed))
+				break;
+		if (seed < 2166136261u + 100000)
+			break;
+	}
+
+	printf("/* Generated by tools/genelem.  Do not edit. */\n\n"
+	       "#include <string.h>\n\n"
+	       "#include \"odf.h\"\n\n");
+
+	printf("static const char *const names[] = {\n");
+	for (i = 0; i < ODF_NUM_ELEMENTS; i++) {
+		if (names[i])
+			printf("\t\"%s\",\n", names[i]);
+		else
+			printf("\t\"\",\n");
+	}
+	printf("};\n\n");
+
+	printf("static const unsigned char lengths[] = {");
+	for (i = 0; i < ODF_NUM_ELEMENTS; i++)
+		printf("%s%lu%s", i % 16 ? " " : "\n\t",
+		       (unsigned long)(names[i] ? strlen(names[i]) : 0),
+		       i < ODF_NUM_ELEMENTS - 1 ? "," : "\n");
+	printf("};\n\n");
+
+	printf("static const enum odf_element slots[%u] = {\n", size);
+	for (i = 0; i < size; i++)
+		printf("\t%s,\n", ids[slots[i]]);
+	printf("};\n\n");
+
+	printf("enum odf_element odf_element(const char *name, size_t len)\n"
+	       "{\n"
+	       "\tunsigned int h = %uu;\n"
+	       "\tenum odf_element e;\n"
+	       "\tsize_t i;\n\n"
+	       "\tif (len > %lu)\n"
+	       "\t\treturn ODF_UNKNOWN;\n"
+	       "\tfor (i = 0; i < len; i++)\n"
+	       "\t\th = (h ^ (unsigned char)name[i]) * %uu;\n"
+	       "\te = slots[h & %u];\n"
+	       "\tif (lengths[e] != len || memcmp(names[e], name, len))\n"
+	       "\t\treturn ODF_UNKNOWN;\n"
+	       "\treturn e;\n"
+	       "}\n",
+	       seed, (unsigned long)max_len, FNV_PRIME, size - 1);
+
+	return 0;
+}
@@ -0,0 +1,731 @@
+/*
+ * genmatch.c: Generates specialized matchers for the fixed regular
+ *             expressions in the sources of odt2txt
+ *
+ * Copyright (c) 2006-2009 Dennis Stosberg <dennis@stosberg.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2 as published by the Free Software Foundation
+ */
+
+/*
+ * Usage: genmatch file.c... > matchers.c
+ *
+ * Every string literal passed to one of the RS_* and RC_* macros is
+ * compiled into a C function which finds the same match as regexec.
+ * Patterns which use more than the supported subset of extended
+ * regular expressions are skipped; regex_subst falls back to POSIX
+ * for them.
+ *
+ * Supported are literal characters, bracket expressions without
+ * character classes, the quantifiers *, +, ? and {n,}, {n}, {n,m},
+ * parentheses without alternatives and nesting, and ^ and $ at the
+ * start and end of the pattern.  A quantified item may overlap with
+ * what follows it only if that is a single literal character, which
+ * the generated code then backtracks to.
+ */
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_ATOMS    64
+#define MAX_PATTERNS 128
+#define INF          -1
+
+enum atom_type {
+	A_SET,          /* a character from set, min to max times */
+	A_OPEN,         /* start of a group */
+	A_CLOSE,        /* end of a group */
+	A_EOL           /* end of the subject */
+};
+
+struct atom {
+	enum atom_type type;
+	unsigned char set[256];
+	int min;
+	int max;
+	int group;
+	int table;      /* number of the set table, or -1 */
+};
+
+struct pattern {
+	char *regex;
+	size_t len;
+	struct atom atoms[MAX_ATOMS];
+	int natoms;
+	int ngroups;
+	int bol;
+};
+
+static struct pattern patterns[MAX_PATTERNS];
+static int npatterns;
+static int nsets;
+
+static void die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	fprintf(stderr, "genmatch: ");
+	vfprintf(stderr, fmt, ap);
+	fprintf(stderr, "\n");
+	va_end(ap);
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * Parses the C string literal at *p.  Adjacent literals are joined.
+ */
+static char *parse_literal(const char **p, size_t *len)
+{
+	const char *s = *p;
+	char *out = malloc(strlen(s) + 1);
+	size_t n = 0;
+	int i, c;
+
+	if (!out)
+		die("out of memory");
+
+	while (*s == '"') {
+		s++;
+		while (*s && *s != '"') {
+			if (*s != '\\') {
+				out[n++] = *s++;
+				continue;
+			}
+			s++;
+			switch (*s) {
+			case 'n': c = '\n'; s++; break;
+			case 't': c = '\t'; s++; break;
+			case 'r': c = '\r'; s++; break;
+			case 'x':
+				s++;
+				for (c = 0, i = 0; i < 2 && isxdigit((unsigned char)*s); i++, s++)
+					c = c * 16 + (isdigit((unsigned char)*s) ? *s - '0'
+						      : tolower((unsigned char)*s) - 'a' + 10);
+				break;
+			default:
+				if (*s >= '0' && *s <= '7') {
+					for (c = 0, i = 0; i < 3 && *s >= '0' && *s <= '7'; i++, s++)
+						c = c * 8 + (*s - '0');
+				} else {
+					c = *s++;
+				}
+			}
+			out[n++] = (char)c;
+		}
+		if (*s != '"')
+			die("unterminated string literal");
+		s++;
+		while (isspace((unsigned char)*s))
+			s++;
+	}
+
+	out[n] = '\0';
+	*len = n;
+	*p = s;
+	return out;
+}
+
+static struct atom *new_atom(struct pattern *pt, enum atom_type type)
+{
+	struct atom *a;
+
+	if (pt->natoms == MAX_ATOMS)
+		return NULL;
+	a = &pt->atoms[pt->natoms++];
+	memset(a, 0, sizeof(*a));
+	a->type = type;
+	a->min = 1;
+	a->max = 1;
+	a->table = -1;
+	return a;
+}
+
+/*
+ * Parses the bracket expression after the '[' at r.  Returns the
+ * position after the closing ']' or NULL if it is not supported.
+ */
+static const char *parse_bracket(const char *r, unsigned char *set)
+{
+	int negate = 0;
+	int first = 1;
+	int c, i;
+
+	if (*r == '^') {
+		negate = 1;
+		r++;
+	}
+	while (*r && (*r != ']' || first)) {
+		if (*r == '[' && (r[1] == ':' || r[1] == '=' || r[1] == '.'))
+			return NULL;
+		c = (unsigned char)*r++;
+		if (*r == '-' && r[1] && r[1] != ']') {
+			for (i = c; i <= (unsigned char)r[1]; i++)
+				set[i] = 1;
+			r += 2;
+		} else {
+			set[c] = 1;
+		}
+		first = 0;
+	}
+	if (*r != ']')
+		return NULL;
+
+	if (negate) {
+		for (i = 0; i < 256; i++)
+			set[i] = !set[i];
+	}
+	return r + 1;
+}
+
+/*
+ * Parses a quantifier at r into a.  Returns the position after it.
+ */
+static const char *parse_quant(const char *r, struct atom *a, int *ok)
+{
+	char *e;
+
+	if (*r == '*') {
+		a->min = 0; a->max = INF;
+		return r + 1;
+	} else if (*r == '+') {
+		a->min = 1; a->max = INF;
+		return r + 1;
+	} else if (*r == '?') {
+		a->min = 0; a->max = 1;
+		return r + 1;
+	} else if (*r == '{') {
+		a->min = (int)strtol(r + 1, &e, 10);
+		if (e == r + 1)
+			*ok = 0;
+		if (*e == '}') {
+			a->max = a->min;
+		} else if (*e == ',' && e[1] == '}') {
+			a->max = INF;
+			e++;
+		} else if (*e == ',') {
+			a->max = (int)strtol(e + 1, &e, 10);
+		}
+		if (*e != '}')
+			*ok = 0;
+		return e + 1;
+	}
+	return r;
+}
+
+static int overlaps(const unsigned char *a, const unsigned char *b)
+{
+	int i;
+
+	for (i = 0; i < 256; i++)
+		if (a[i] && b[i])
+			return 1;
+	return 0;
+}
+
+static int is_single(const struct atom *a)
+{
+	int i, n = 0;
+
+	if (a->type != A_SET || a->min != 1 || a->max != 1)
+		return 0;
+	for (i = 0; i < 256; i++)
+		n += a->set[i];
+	return n == 1;
+}
+
+/*
+ * Returns 1 if the quantified atom i may have to give back
+ * characters to what follows it.
+ */
+static int backtracks(const struct pattern *pt, int i)
+{
+	const struct atom *a = &pt->atoms[i];
+	unsigned char follow[256];
+	int j, k;
+
+	if (a->type != A_SET || a->min == a->max)
+		return 0;
+
+	memset(follow, 0, sizeof(follow));
+	for (j = i + 1; j < pt->natoms; j++) {
+		if (pt->atoms[j].type != A_SET)
+			continue;
+		for (k = 0; k < 256; k++)
+			follow[k] |= pt->atoms[j].set[k];
+		if (pt->atoms[j].min > 0)
+			break;
+	}
+	return overlaps(a->set, follow);
+}
+
+/*
+ * Returns the next atom after i which consumes characters.
+ */
+static const struct atom *next_set(const struct pattern *pt, int i)
+{
+	for (i++; i < pt->natoms; i++)
+		if (pt->atoms[i].type == A_SET)
+			return &pt->atoms[i];
+	return NULL;
+}
+
+/*
+ * Checks that every quantified item which overlaps with what may
+ * follow it is followed by a single literal character.
+ */
+static int check_quantifiers(const struct pattern *pt)
+{
+	const struct atom *next;
+	int i;
+
+	for (i = 0; i < pt->natoms; i++) {
+		if (!backtracks(pt, i))
+			continue;
+		next = next_set(pt, i);
+		if (!next || !is_single(next))
+			return 0;
+	}
+	return 1;
+}
+
+static int parse_regex(struct pattern *pt)
+{
+	const char *r = pt->regex;
+	struct atom *a;
+	int in_group = 0;
+	int ok = 1;
+
+	if (strlen(pt->regex) != pt->len)
+		return 0;
+
+	if (*r == '^') {
+		pt->bol = 1;
+		r++;
+	}
+
+	while (*r && ok) {
+		switch (*r) {
+		case '(':
+			if (in_group || !(a = new_atom(pt, A_OPEN)))
+				return 0;
+			a->group = ++pt->ngroups;
+			in_group = 1;
+			r++;
+			continue;
+		case ')':
+			if (!in_group || !(a = new_atom(pt, A_CLOSE)))
+				return 0;
+			a->group = pt->ngroups;
+			in_group = 0;
+			r++;
+			if (*r == '*' || *r == '+' || *r == '?' || *r == '{')
+				return 0;
+			continue;
+		case '$':
+			if (r[1] || !new_atom(pt, A_EOL))
+				return 0;
+			r++;
+			continue;
+		case '|': case '.': case '^': case '*': case '+': case '?':
+		case '{': case '}': case ']':
+			return 0;
+		}
+
+		if (!(a = new_atom(pt, A_SET)))
+			return 0;
+		if (*r == '[') {
+			r = parse_bracket(r + 1, a->set);
+			if (!r)
+				return 0;
+		} else {
+			if (*r == '\\') {
+				r++;
+				if (!*r || isalnum((unsigned char)*r))
+					return 0;
+			}
+			a->set[(unsigned char)*r++] = 1;
+		}
+		r = parse_quant(r, a, &ok);
+		if (a->max != INF && a->max < a->min)
+			ok = 0;
+	}
+
+	return ok && !in_group && check_quantifiers(pt);
+}
+
+static void add_pattern(char *regex, size_t len)
+{
+	int i;
+
+	for (i = 0; i < npatterns; i++) {
+		if (patterns[i].len == len && !memcmp(patterns[i].regex, regex, len)) {
+			free(regex);
+			return;
+		}
+	}
+	if (npatterns == MAX_PATTERNS)
+		die("too many patterns");
+
+	patterns[npatterns].regex = regex;
+	patterns[npatterns].len = len;
+	if (!parse_regex(&patterns[npatterns])) {
+		fprintf(stderr, "genmatch: not supported, using POSIX: %s\n",
+			regex);
+		free(regex);
+		memset(&patterns[npatterns], 0, sizeof(struct pattern));
+		return;
+	}
+	npatterns++;
+}
+
+static void scan_file(const char *filename)
+{
+	static const char *macros[] = {
+		"RS_O(", "RS_G(", "RS_E(", "RC_G(", "RC_E(", NULL
+	};
+	FILE *f = fopen(filename, "r");
+	char *src;
+	const char *p;
+	long size;
+	size_t len;
+	int i;
+
+	if (!f)
+		die("can't open %s", filename);
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	src = malloc((size_t)size + 1);
+	if (!src || fread(src, 1, (size_t)size, f) != (size_t)size)
+		die("can't read %s", filename);
+	src[size] = '\0';
+	fclose(f);
+
+	for (i = 0; macros[i]; i++) {
+		p = src;
+		while ((p = strstr(p, macros[i]))) {
+			p += strlen(macros[i]);
+			while (isspace((unsigned char)*p))
+				p++;
+			if (*p == '"') {
+				char *regex = parse_literal(&p, &len);
+				add_pattern(regex, len);
+			}
+		}
+	}
+	free(src);
+}
+
+static void put_char(int c)
+{
+	if (c == '\'' || c == '\\')
+		printf("'\\%c'", c);
+	else if (isprint(c))
+		printf("'%c'", c);
+	else
+		printf("'\\%03o'", c);
+}
+
+static void put_string(const char *s, size_t len)
+{
+	size_t i;
+
+	putchar('"');
+	for (i = 0; i < len; i++) {
+		unsigned char c = (unsigned char)s[i];
+
+		if (c == '"' || c == '\\')
+			printf("\\%c", c);
+		else if (isprint(c))
+			putchar(c);
+		else
+			printf("\\%03o", c);
+	}
+	putchar('"');
+}
+
+static void indent(int depth)
+{
+	while (depth--)
+		putchar('\t');
+}
+
+/*
+ * Emits a condition which is true if the character expression c is
+ * in the set of a.
+ */
+static void put_cond(const struct atom *a, const char *c)
+{
+	int i, n = 0, last = 0, missing = 0;
+
+	for (i = 0; i < 256; i++) {
+		if (a->set[i]) {
+			n++;
+			last = i;
+		} else {
+			missing = i;
+		}
+	}
+
+	if (n == 1) {
+		printf("%s == ", c);
+		put_char(last);
+	} else if (n == 255) {
+		printf("%s != ", c);
+		put_char(missing);
+	} else {
+		printf("rx_set%d[(unsigned char)%s]", a->table, c);
+	}
+}
+
+/*
+ * Emits the code matching atoms i.. of pt at p.  fail is the
+ * statement to leave the current alternative.
+ */
+static void emit(const struct pattern *pt, int i, int depth,
+		 const char *fail)
+{
+	const struct atom *a;
+	const struct atom *next;
+	char buf[256];
+	size_t n;
+	int j;
+
+	for (; i < pt->natoms; i++) {
+		a = &pt->atoms[i];
+
+		switch (a->type) {
+		case A_OPEN:
+			indent(depth);
+			printf("g%d = p;\n", a->group);
+			continue;
+		case A_CLOSE:
+			indent(depth);
+			printf("m[%d].rm_so = g%d - s;\n", a->group, a->group);
+			indent(depth);
+			printf("m[%d].rm_eo = p - s;\n", a->group);
+			continue;
+		case A_EOL:
+			indent(depth);
+			printf("if (p != end)\n");
+			indent(depth + 1);
+			printf("%s\n", fail);
+			continue;
+		case A_SET:
+			break;
+		}
+
+		if (is_single(a)) {
+			/* a run of literal characters */
+			for (n = 0, j = i; j < pt->natoms && is_single(&pt->atoms[j]); j++) {
+				int c;
+
+				for (c = 0; !pt->atoms[j].set[c]; c++)
+					;
+				buf[n++] = (char)c;
+			}
+			i = j - 1;
+			indent(depth);
+			if (n == 1) {
+				printf("if (p == end || *p != ");
+				put_char((unsigned char)buf[0]);
+				printf(")\n");
+			} else {
+				printf("if ((size_t)(end - p) < %lu || memcmp(p, ",
+				       (unsigned long)n);
+				put_string(buf, n);
+				printf(", %lu))\n", (unsigned long)n);
+			}
+			indent(depth + 1);
+			printf("%s\n", fail);
+			indent(depth);
+			printf("p += %lu;\n", (unsigned long)n);
+			continue;
+		}
+
+		if (a->min == 1 && a->max == 1) {
+			indent(depth);
+			printf("if (p == end || !(");
+			put_cond(a, "*p");
+			printf("))\n");
+			indent(depth + 1);
+			printf("%s\n", fail);
+			indent(depth);
+			printf("p++;\n");
+			continue;
+		}
+
+		/* quantified: take the longest run */
+		indent(depth);
+		printf("for (q = p; q < end");
+		if (a->max != INF)
+			printf(" && q - p < %d", a->max);
+		printf(" && (");
+		put_cond(a, "*q");
+		printf("); q++)\n");
+		indent(depth + 1);
+		printf(";\n");
+		if (a->min) {
+			indent(depth);
+			printf("if (q - p < %d)\n", a->min);
+			indent(depth + 1);
+			printf("%s\n", fail);
+		}
+
+		if (!backtracks(pt, i)) {
+			/* nothing that follows can take from the run */
+			indent(depth);
+			printf("p = q;\n");
+			continue;
+		}
+
+		/* give back characters until the next one matches */
+		next = next_set(pt, i);
+		indent(depth);
+		printf("start%d = p;\n", i);
+		indent(depth);
+		printf("for (n%d = q - p; n%d >= %d; n%d--) {\n", i, i, a->min, i);
+		indent(depth + 1);
+		printf("p = start%d + n%d;\n", i, i);
+		indent(depth + 1);
+		printf("if (p == end || !(");
+		put_cond(next, "*p");
+		printf("))\n");
+		indent(depth + 2);
+		printf("continue;\n");
+		emit(pt, i + 1, depth + 1, "continue;");
+		indent(depth);
+		printf("}\n");
+		indent(depth);
+		printf("%s\n", fail);
+		return;
+	}
+
+	indent(depth);
+	printf("m[0].rm_eo = p - s;\n");
+	indent(depth);
+	printf("return 1;\n");
+}
+
+static void emit_pattern(int n)
+{
+	struct pattern *pt = &patterns[n];
+	struct atom *first = NULL;
+	int i, j;
+
+	printf("/* ");
+	put_string(pt->regex, pt->len);
+	printf(" */\n");
+
+	/* the sets which need a table */
+	for (i = 0; i < pt->natoms; i++) {
+		struct atom *a = &pt->atoms[i];
+		int count = 0;
+
+		if (a->type != A_SET)
+			continue;
+		for (j = 0; j < 256; j++)
+			count += a->set[j];
+		if (count == 1 || count == 255)
+			continue;
+
+		a->table = nsets++;
+		printf("static const unsigned char rx_set%d[256] = {", a->table);
+		for (j = 0; j < 256; j++)
+			printf("%s%d%s", j % 32 ? "" : "\n\t", a->set[j],
+			       j < 255 ? "," : "\n");
+		printf("};\n\n");
+	}
+
+	printf("static int rx_at%d(const char *s, const char *p, const char *end,\n"
+	       "\t\t   regmatch_t m[])\n{\n", n);
+	for (i = 1; i <= pt->ngroups; i++)
+		printf("\tconst char *g%d;\n", i);
+	for (i = 0; i < pt->natoms; i++)
+		if (pt->atoms[i].type == A_SET && pt->atoms[i].min != pt->atoms[i].max)
+			break;
+	if (i < pt->natoms)
+		printf("\tconst char *q;\n");
+	for (i = 0; i < pt->natoms; i++) {
+		if (backtracks(pt, i))
+			printf("\tconst char *start%d;\n\tptrdiff_t n%d;\n", i, i);
+	}
+	printf("\n");
+	emit(pt, 0, 1, "return 0;");
+	printf("}\n\n");
+
+	for (i = 0; i < pt->natoms && pt->atoms[i].type == A_OPEN; i++)
+		;
+	if (i < pt->natoms && is_single(&pt->atoms[i]))
+		first = &pt->atoms[i];
+
+	printf("static int rx_match%d(const char *s, size_t len, regmatch_t m[],\n"
+	       "\t\t      size_t nmatch)\n{\n", n);
+	printf("\tconst char *end = s + len;\n"
+	       "\tconst char *p = s;\n"
+	       "\tregmatch_t g[%d];\n"
+	       "\tsize_t i;\n\n", pt->ngroups + 1);
+	if (pt->bol) {
+		printf("\tif (!rx_at%d(s, p, end, g))\n\t\treturn 0;\n", n);
+	} else if (first) {
+		for (j = 0; !first->set[j]; j++)
+			;
+		printf("\tfor (;; p++) {\n"
+		       "\t\tp = memchr(p, ");
+		put_char(j);
+		printf(", (size_t)(end - p));\n"
+		       "\t\tif (!p)\n\t\t\treturn 0;\n"
+		       "\t\tif (rx_at%d(s, p, end, g))\n\t\t\tbreak;\n"
+		       "\t}\n", n);
+	} else {
+		printf("\tfor (;; p++) {\n"
+		       "\t\tif (rx_at%d(s, p, end, g))\n\t\t\tbreak;\n"
+		       "\t\tif (p == end)\n\t\t\treturn 0;\n"
+		       "\t}\n", n);
+	}
+	printf("\tg[0].rm_so = p - s;\n\n"
+	       "\tfor (i = 0; i < nmatch; i++) {\n"
+	       "\t\tif (i < %d) {\n"
+	       "\t\t\tm[i] = g[i];\n"
+	       "\t\t} else {\n"
+	       "\t\t\tm[i].rm_so = -1;\n"
+	       "\t\t\tm[i].rm_eo = -1;\n"
+	       "\t\t}\n"
+	       "\t}\n"
+	       "\treturn 1;\n"
+	       "}\n\n", pt->ngroups + 1);
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	if (argc < 2)
+		die("usage: genmatch file.c... > matchers.c");
+	for (i = 1; i < argc; i++)
+		scan_file(argv[i]);
+
+	printf("/* Generated by tools/genmatch.  Do not edit. */\n\n"
+	       "#include <stddef.h>\n"
+	       "#include <string.h>\n\n"
+	       "#include \"matchers.h\"\n\n");
+
+	for (i = 0; i < npatterns; i++)
+		emit_pattern(i);
+
+	printf("const struct matcher matchers[] = {\n");
+	for (i = 0; i < npatterns; i++) {
+		printf("\t{ ");
+		put_string(patterns[i].regex, patterns[i].len);
+		printf(", rx_match%d },\n", i);
+	}
+	printf("\t{ NULL, NULL }\n};\n");
+
+	return 0;
+}
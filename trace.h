@@ -0,0 +1,54 @@
+/*
+ * trace.h: Static tracepoints
+ *
+ * Copyright (c) 2006-2009 Dennis Stosberg <dennis@stosberg.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License,
+ * version 2 as published by the Free Software Foundation
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * USDT probes of the provider "odt2txt", which bpftrace, perf or
+ * SystemTap can attach to a running program, e.g.
+ *
+ *   bpftrace -e 'usdt:./odt2txt:odt2txt:wrap__done
+ *                { @[arg0] = arg1 }'
+ *
+ * They are built with SDT=1, which needs <sys/sdt.h> from SystemTap.
+ * An unused probe costs a nop.  Without SDT=1 they are compiled out
+ * and their arguments are not evaluated.
+ *
+ * The probes of the conversion of a document carry its id, which
+ * counts the documents of a process from 1, and byte counts:
+ *
+ *   doc__start(id, filename, file size)
+ *   doc__done(id, filename, bytes of output for the first target)
+ *   read__start(id)                     read__done(id, bytes)
+ *   subst__start(id, bytes)             subst__done(id, bytes)
+ *   format__start(id, bytes)            format__done(id, bytes)
+ *   wrap__start(id, bytes)              wrap__done(id, bytes)
+ *   conv__start(id, bytes)              conv__done(id, bytes)
+ *
+ * strbuf__grow(old size, new size, length) fires whenever a string
+ * buffer gets a larger backing store.  It has no document id; the
+ * thread which fires it is converting the last document started in
+ * its process.
+ */
+#ifdef HAVE_SDT
+#  include <sys/sdt.h>
+#  define TRACE1(name, a)          DTRACE_PROBE1(odt2txt, name, a)
+#  define TRACE2(name, a, b)       DTRACE_PROBE2(odt2txt, name, a, b)
+#  define TRACE3(name, a, b, c)    DTRACE_PROBE3(odt2txt, name, a, b, c)
+#else
+/* sizeof uses the arguments without evaluating them */
+#  define TRACE1(name, a)          ((void)sizeof(a))
+#  define TRACE2(name, a, b)       ((void)sizeof(a), (void)sizeof(b))
+#  define TRACE3(name, a, b, c) \
+	((void)sizeof(a), (void)sizeof(b), (void)sizeof(c))
+#endif
+
+#endif /* TRACE_H */